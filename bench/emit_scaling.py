@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+# in a sequential program given in high level language like C/C++ into a DFG.
+# This script checks that writing the .graph file scales linearly.
+# For complete list of authors refer to AUTHORS.txt.
+# For more details about the license refer to LICENSE.txt.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+
+"""Check that the Emit phase of the text format grows linearly with the graph.
+
+One loop of 10^3, 10^4, 10^5 and 10^6 instructions (--max limits the largest)
+is generated with gen_loops.py by unrolling a body of 100 instructions, and
+opt runs the pass on it --repeat times with -dfg-format=text. The fastest Emit
+time of every size comes from -dfg-report. The exponent of the time in the
+number of nodes is fitted by least squares over the sizes whose Emit time is at
+least --min-time; the script exits with status 1 if it is above 1 + --tolerance,
+e.g. if the .graph writer became quadratic again.
+"""
+
+import argparse
+import math
+import os
+import sys
+
+import run_bench
+
+SIZES = [10, 100, 1000, 10000]	# copies of the body, 100 instructions each
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--opt", default="opt", help="opt binary (default: opt on PATH)")
+    parser.add_argument("--pass", dest="pass_lib", required=True, help="path of loop_graph_analysis_0.so")
+    parser.add_argument("--work", default="bench_work", help="directory for inputs and outputs")
+    parser.add_argument("--max", type=int, default=1000000, help="largest loop in instructions (default 10^6)")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--tolerance", type=float, default=0.25, help="allowed excess of the exponent over 1 (default 0.25)")
+    parser.add_argument("--min-time", type=float, default=0.001, help="Emit times below this many seconds are not fitted")
+    parser.add_argument("--syntax", choices=["3.4", "3.7"], default="3.4", help="IR syntax of the generated inputs")
+    parser.add_argument("--opt-flag", dest="opt_flags", action="append", default=[], help="extra flag for opt before -load")
+    opts = parser.parse_args()
+    opts.pass_args = ["-dfg-format=text"]
+
+    work = os.path.abspath(opts.work)
+    if not os.path.isdir(work):
+        os.makedirs(work)
+
+    points = []
+    for unroll in SIZES:
+        if unroll * 100 > opts.max:
+            break
+        case = {"name": "emit_%d" % (unroll * 100), "args": ["--loops", "1", "--body", "100", "--unroll", str(unroll)]}
+        input_path = run_bench.generate(case, opts.syntax, work)
+        rundir = os.path.join(work, case["name"])
+        if not os.path.isdir(rundir):
+            os.makedirs(rundir)
+
+        best = None
+        for _ in range(opts.repeat):
+            _, _, report = run_bench.run_once(opts, input_path, rundir)
+            module = report["module"]
+            if best is None or module["time"]["Emit"] < best[1]:
+                best = (module["nodes"], module["time"]["Emit"])
+        nodes, emit = best
+        print("%-12s %9d nodes %9.4f s %8.1f ns/node" % (case["name"], nodes, emit, 1e9 * emit / max(nodes, 1)))
+        sys.stdout.flush()
+        if emit >= opts.min_time:
+            points.append((math.log(nodes), math.log(emit)))
+
+    if len(points) < 2:
+        print("fewer than two sizes took --min-time, nothing to fit")
+        return 0
+    mx = sum(x for x, _ in points) / len(points)
+    my = sum(y for _, y in points) / len(points)
+    slope = sum((x - mx) * (y - my) for x, y in points) / sum((x - mx) ** 2 for x, _ in points)
+    print("Emit time ~ nodes^%.2f" % slope)
+    if slope > 1 + opts.tolerance:
+        print("REGRESSION emit: exponent %.2f above %.2f" % (slope, 1 + opts.tolerance))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
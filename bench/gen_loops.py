@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+# in a sequential program given in high level language like C/C++ into a DFG.
+# This script generates synthetic loop IR for benchmarking the pass.
+# For complete list of authors refer to AUTHORS.txt.
+# For more details about the license refer to LICENSE.txt.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+
+"""Generate an LLVM IR module of synthetic loop nests.
+
+Every loop nest is a function of its own. The innermost loop body is a
+random mix of integer arithmetic, GEP + load pairs and if-then diamonds
+joined by phis, and ends with a store. The knobs are:
+
+  --loops        number of loop nests (functions)
+  --body         instructions per copy of the innermost body
+  --unroll       copies of the body in the innermost loop
+  --nesting      depth of every loop nest
+  --branch       probability that a body slot opens an if-then diamond
+  --gep          probability that a body slot is a GEP + load
+  --live-ins     i32 arguments used by the body (data nodes of the graph)
+  --arrays       i32* arguments the body loads from
+
+The total size is roughly loops * unroll * body instructions. Output is
+deterministic for a given --seed. --syntax 3.4 (the default) writes the
+load and getelementptr form of LLVM 3.4; 3.7 writes the explicit-type form
+of later releases.
+"""
+
+import argparse
+import random
+import sys
+
+
+class Body(object):
+    """Builds the instructions of one function, keeps track of the current block."""
+
+    def __init__(self, args, rng, lines):
+        self.args = args
+        self.rng = rng
+        self.lines = lines
+        self.counter = 0
+        self.instructions = 0
+
+    def name(self, prefix):
+        self.counter += 1
+        return "%%%s%d" % (prefix, self.counter)
+
+    def emit(self, text):
+        self.lines.append("  " + text)
+        self.instructions += 1
+
+    def label(self, name):
+        self.lines.append("%s:" % name)
+
+    def load(self, array, index):
+        ptr = self.name("p")
+        val = self.name("v")
+        if self.args.syntax == "3.4":
+            self.emit("%s = getelementptr inbounds i32* %s, i64 %s" % (ptr, array, index))
+            self.emit("%s = load i32* %s, align 4" % (val, ptr))
+        else:
+            self.emit("%s = getelementptr inbounds i32, i32* %s, i64 %s" % (ptr, array, index))
+            self.emit("%s = load i32, i32* %s, align 4" % (val, ptr))
+        return val
+
+    def store(self, value, array, index):
+        ptr = self.name("p")
+        if self.args.syntax == "3.4":
+            self.emit("%s = getelementptr inbounds i32* %s, i64 %s" % (ptr, array, index))
+        else:
+            self.emit("%s = getelementptr inbounds i32, i32* %s, i64 %s" % (ptr, array, index))
+        self.emit("store i32 %s, i32* %s, align 4" % (value, ptr))
+
+    def arith(self, values):
+        op = self.rng.choice(["add", "sub", "mul", "xor", "and", "or"])
+        res = self.name("t")
+        self.emit("%s = %s i32 %s, %s" % (res, op, self.rng.choice(values), self.rng.choice(values)))
+        return res
+
+    def copy(self, block, index, values):
+        """One copy of the innermost body, starting in block. Returns the block it ends in."""
+        args = self.args
+        rng = self.rng
+        slot = 0
+        while slot < args.body:
+            r = rng.random()
+            if r < args.gep and args.arrays > 0:
+                values.append(self.load("%%a%d" % rng.randrange(args.arrays), index))
+                slot += 2
+            elif r < args.gep + args.branch and slot + 4 <= args.body:
+                cond = self.name("c")
+                before = rng.choice(values)
+                self.emit("%s = icmp slt i32 %s, 0" % (cond, before))
+                then = self.name("then")[1:]
+                join = self.name("join")[1:]
+                self.emit("br i1 %s, label %%%s, label %%%s" % (cond, then, join))
+                self.label(then)
+                inside = self.arith(values)
+                self.emit("br label %%%s" % join)
+                self.label(join)
+                merged = self.name("m")
+                self.emit("%s = phi i32 [ %s, %%%s ], [ %s, %%%s ]" % (merged, inside, then, before, block))
+                values.append(merged)
+                block = join
+                slot += 5
+            else:
+                values.append(self.arith(values))
+                slot += 1
+        return block
+
+
+def gen_function(args, rng, f, lines):
+    params = ["i32* %%a%d" % a for a in range(args.arrays)]
+    params += ["i32 %%x%d" % x for x in range(args.live_ins)]
+    params.append("i64 %n")
+    lines.append("define void @loop%d(%s) nounwind {" % (f, ", ".join(params)))
+    lines.append("entry:")
+    body = Body(args, rng, lines)
+    body.emit("br label %h0")
+
+    pred = "entry"
+    for level in range(args.nesting):  # headers of the nest, outermost first
+        lines.append("h%d:" % level)
+        body.emit("%%i%d = phi i64 [ 0, %%%s ], [ %%i%d.next, %%latch%d ]" % (level, pred, level, level))
+        pred = "h%d" % level
+        if level + 1 < args.nesting:
+            body.emit("br label %%h%d" % (level + 1))
+
+    inner = args.nesting - 1
+    values = ["%%x%d" % x for x in range(args.live_ins)] or ["0"]
+    block = "h%d" % inner
+    index = "%%i%d" % inner
+    for u in range(args.unroll):
+        if u > 0:  # every copy reads at its own offset
+            index = body.name("idx")
+            body.emit("%s = add i64 %%i%d, %d" % (index, inner, u))
+        block = body.copy(block, index, values)
+        if args.arrays > 0:
+            body.store(values[-1], "%a0", index)
+    body.emit("br label %%latch%d" % inner)
+
+    for level in range(inner, -1, -1):  # latches, innermost first
+        lines.append("latch%d:" % level)
+        body.emit("%%i%d.next = add i64 %%i%d, 1" % (level, level))
+        body.emit("%%cmp%d = icmp slt i64 %%i%d.next, %%n" % (level, level))
+        exit_label = "latch%d" % (level - 1) if level > 0 else "exit"
+        body.emit("br i1 %%cmp%d, label %%h%d, label %%%s" % (level, level, exit_label))
+
+    lines.append("exit:")
+    body.emit("ret void")
+    lines.append("}")
+    lines.append("")
+    return body.instructions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--loops", type=int, default=1)
+    parser.add_argument("--body", type=int, default=50)
+    parser.add_argument("--unroll", type=int, default=1)
+    parser.add_argument("--nesting", type=int, default=1)
+    parser.add_argument("--branch", type=float, default=0.05)
+    parser.add_argument("--gep", type=float, default=0.2)
+    parser.add_argument("--live-ins", type=int, default=4)
+    parser.add_argument("--arrays", type=int, default=2)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--syntax", choices=["3.4", "3.7"], default="3.4")
+    parser.add_argument("-o", "--output", default="-")
+    args = parser.parse_args()
+
+    if args.loops < 1 or args.body < 1 or args.unroll < 1 or args.nesting < 1:
+        parser.error("--loops, --body, --unroll and --nesting must be at least 1")
+    if args.branch < 0 or args.gep < 0 or args.branch + args.gep > 1:
+        parser.error("--branch and --gep are probabilities and must add up to at most 1")
+
+    rng = random.Random(args.seed)
+    lines = []
+    total = 0
+    for f in range(args.loops):
+        total += gen_function(args, rng, f, lines)
+
+    header = ["; generated by gen_loops.py %s" % " ".join(sys.argv[1:]),
+              "; instructions: %d" % total, ""]
+    text = "\n".join(header + lines)
+    if args.output == "-":
+        sys.stdout.write(text)
+    else:
+        with open(args.output, "w") as out:
+            out.write(text)
+
+
+if __name__ == "__main__":
+    main()
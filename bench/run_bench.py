@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+#
+# DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+# in a sequential program given in high level language like C/C++ into a DFG.
+# This script runs the benchmark suite and checks it against a baseline.
+# For complete list of authors refer to AUTHORS.txt.
+# For more details about the license refer to LICENSE.txt.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+
+"""Run loop-graph-analysis-0 on the benchmark suite.
+
+For every case of the suite the input is generated with gen_loops.py (once,
+it is kept in the work directory), then opt runs the pass --repeat times with
+-dfg-quiet and -dfg-report. The fastest run gives the wall time of the whole
+opt process and of every phase from the report; peak RSS is taken from the
+kernel for the opt process. Results are written to <work>/results.json.
+
+With --record the results become the baseline. Otherwise they are compared
+to the baseline and the script exits with status 1 if a case got slower or
+bigger than the tolerance allows. Only the Python standard library is used,
+nothing is downloaded.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def generate(case, syntax, work):
+    """Generate the input of a case unless it is already there with the same arguments."""
+    path = os.path.join(work, case["name"] + ".ll")
+    args = case["args"] + ["--syntax", syntax]
+    stamp = "; generated by gen_loops.py %s -o %s" % (" ".join(args), path)
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.readline().rstrip("\n") == stamp:
+                return path
+    subprocess.check_call([sys.executable, os.path.join(HERE, "gen_loops.py")] + args + ["-o", path])
+    return path
+
+
+def instructions(path):
+    with open(path) as f:
+        f.readline()
+        line = f.readline()
+    return int(line.split(":")[1]) if line.startswith("; instructions:") else 0
+
+
+def run_once(opts, input_path, rundir):
+    """One opt run, returns (wall seconds, peak RSS in KB, report)."""
+    report = os.path.join(rundir, "report.json")
+    if os.path.exists(report):
+        os.remove(report)
+    cmd = [opts.opt] + opts.opt_flags + ["-load", opts.pass_lib, "-loop-graph-analysis-0",
+                                         "-dfg-quiet", "-dfg-report=" + report] + opts.pass_args + [input_path, "-o", os.devnull]
+    with open(os.path.join(rundir, "stdout.txt"), "w") as out, open(os.path.join(rundir, "stderr.txt"), "w") as err:
+        start = time.time()
+        proc = subprocess.Popen(cmd, cwd=rundir, stdout=out, stderr=err)
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = time.time() - start
+    proc.returncode = status
+    if status != 0:
+        raise RuntimeError("opt failed (status %d), see %s" % (status, os.path.join(rundir, "stderr.txt")))
+    with open(report) as f:
+        data = json.load(f)
+    return wall, usage.ru_maxrss, data
+
+
+def run_case(opts, case, work):
+    input_path = generate(case, opts.syntax, work)
+    rundir = os.path.join(work, case["name"])
+    if not os.path.isdir(rundir):
+        os.makedirs(rundir)
+
+    best = None
+    for _ in range(opts.repeat):
+        wall, rss, report = run_once(opts, input_path, rundir)
+        if best is None or wall < best["wall"]:
+            module = report["module"]
+            best = {"wall": wall, "peakRSSKB": rss, "phases": module["time"],
+                    "loops": module["loops"], "nodes": module["nodes"], "edges": module["edges"],
+                    "instructions": instructions(input_path)}
+    return best
+
+
+def compare(name, result, base, opts):
+    """Regressions of one case against its baseline, as a list of messages."""
+    problems = []
+
+    def check(what, new, old, tolerance, floor):
+        if old < floor and new < floor:	# too small to measure reliably
+            return
+        if new > old * (1 + tolerance) + floor:
+            problems.append("%s: %s %.4g -> %.4g (+%.0f%%)" % (name, what, old, new, 100.0 * (new - old) / max(old, 1e-9)))
+
+    check("wall s", result["wall"], base["wall"], opts.tolerance, opts.min_time)
+    for phase, seconds in sorted(result["phases"].items()):
+        check(phase + " s", seconds, base["phases"].get(phase, 0), opts.tolerance, opts.min_time)
+    check("peak RSS KB", result["peakRSSKB"], base["peakRSSKB"], opts.mem_tolerance, 1024)
+    for count in ("nodes", "edges"):	# the graphs themselves should not change unnoticed
+        if result[count] != base.get(count, result[count]):
+            problems.append("%s: %s %d -> %d" % (name, count, base[count], result[count]))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--opt", default="opt", help="opt binary (default: opt on PATH)")
+    parser.add_argument("--pass", dest="pass_lib", required=True, help="path of loop_graph_analysis_0.so")
+    parser.add_argument("--suite", default=os.path.join(HERE, "suite.json"))
+    parser.add_argument("--baseline", default=os.path.join(HERE, "baseline.json"))
+    parser.add_argument("--work", default="bench_work", help="directory for inputs and outputs")
+    parser.add_argument("--record", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--large", action="store_true", help="include the large cases")
+    parser.add_argument("--only", action="append", default=[], help="run only this case (repeatable)")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed relative slowdown (default 0.10)")
+    parser.add_argument("--mem-tolerance", type=float, default=0.10, help="allowed relative growth of peak RSS")
+    parser.add_argument("--min-time", type=float, default=0.02, help="times below this many seconds are not compared")
+    parser.add_argument("--syntax", choices=["3.4", "3.7"], default="3.4", help="IR syntax of the generated inputs")
+    parser.add_argument("--opt-flag", dest="opt_flags", action="append", default=[], help="extra flag for opt before -load")
+    parser.add_argument("--pass-arg", dest="pass_args", action="append", default=[], help="extra pass option, e.g. -dfg-threads=4")
+    opts = parser.parse_args()
+
+    with open(opts.suite) as f:
+        cases = json.load(f)["cases"]
+    cases = [c for c in cases if (opts.large or not c.get("large")) and (not opts.only or c["name"] in opts.only)]
+    work = os.path.abspath(opts.work)
+    if not os.path.isdir(work):
+        os.makedirs(work)
+
+    results = {}
+    for case in cases:
+        result = run_case(opts, case, work)
+        results[case["name"]] = result
+        print("%-12s %9d ins %9.3f s %9d KB" % (case["name"], result["instructions"], result["wall"], result["peakRSSKB"]))
+        sys.stdout.flush()
+
+    with open(os.path.join(work, "results.json"), "w") as f:
+        json.dump(results, f, indent=1, sort_keys=True)
+
+    if opts.record:
+        baseline = {}
+        if os.path.exists(opts.baseline):	# keep cases that were not run this time
+            with open(opts.baseline) as f:
+                baseline = json.load(f)
+        baseline.update(results)
+        with open(opts.baseline, "w") as f:
+            json.dump(baseline, f, indent=1, sort_keys=True)
+        print("baseline written to %s" % opts.baseline)
+        return 0
+
+    if not os.path.exists(opts.baseline):
+        print("no baseline at %s, run with --record first" % opts.baseline)
+        return 0
+    with open(opts.baseline) as f:
+        baseline = json.load(f)
+
+    problems = []
+    for name, result in sorted(results.items()):
+        if name not in baseline:
+            print("%s: not in the baseline" % name)
+            continue
+        problems += compare(name, result, baseline[name], opts)
+
+    for p in problems:
+        print("REGRESSION " + p)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
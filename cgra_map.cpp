@@ -0,0 +1,962 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the placement and routing of loop graphs on a CGRA.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "cgra_map.h"
+#include "modulo_schedule.h"
+#include "latency_model.h"
+#include "dfg_cache.h"
+#include "work_pool.h"
+#include "llvm/Support/Timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	const char* topologyNames[NUM_TOPOLOGIES] = {
+		"mesh",
+		"torus",
+		"diagonal",
+		"hop"
+	};
+
+	const unsigned int noOp = ~0U;	//free PE cycle
+	const unsigned int unreachable = ~0U;
+	const unsigned int clockSteps = 256;	//steps between looks at the clock
+	const unsigned int movesPerOp = 16;	//annealing moves per operation at every temperature
+	const unsigned int maxRounds = 200;	//temperatures
+	const double cooling = 0.9;
+	const double latePenalty = 100;	//annealing cost of a hop the value has no cycle for
+	const unsigned int routeRounds = 64;	//PathFinder rounds before a placement is given up
+	const unsigned int routeStall = 16;	//or rounds without less overuse
+	const double infinite = 1e30;
+
+	int ParseIndex(const char* text, unsigned int& index) {	//-1 for *, 0 if it is no number
+		if (strcmp(text, "*") == 0) return -1;
+		char* end = 0;
+		unsigned long value = strtoul(text, &end, 10);
+		if (end == text || *end) return 0;
+		index = value;
+		return 1;
+	}
+
+	double Now() {
+		return TimeRecord::getCurrentTime(true).getWallTime();
+	}
+
+	class random_stream {	//xorshift64*, one per restart so that the restarts do not depend on each other
+		public:
+			explicit random_stream(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+			uint64_t Next() {
+				state ^= state >> 12;
+				state ^= state << 25;
+				state ^= state >> 27;
+				return state * 2685821657736338717ULL;
+			}
+			unsigned int Below(unsigned int n) { return Next() % n; }
+			double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }	//in [0, 1)
+		private:
+			uint64_t state;
+	};
+
+	typedef struct
+	{
+		unsigned int node;	//index in the graph
+		fu_class fu;
+		unsigned int occupancy;	//cycles it holds its PE, 0 for none
+		unsigned int delay;	//latency, negative latencies count as 0
+	}map_op;
+
+	typedef struct
+	{
+		unsigned int src;	//operations
+		unsigned int dst;
+		unsigned int distance;
+	}map_edge;	//a value the consumer reads, from a data or control dependence
+
+	class map_problem {	//the operations and values of a loop, read by all restarts
+		public:
+			map_problem(const clust_graph& graph, const cgra_grid& grid) : grid(grid), maxOccupancy(0) {
+				vector<unsigned int> opOf(graph.NumNodes(), noOp);
+				memset(demand, 0, sizeof(demand));
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+					const clust_node& node = graph.Node(n);
+					if (node.removed || node.nodeType != INSTNODE) continue;
+					map_op op;
+					op.node = n;
+					op.fu = node.fu;
+					op.occupancy = (node.fu == FU_NONE) ? 0 : max(node.ii, 1U);
+					op.delay = max(node.latency, 0);
+					opOf[n] = ops.size();
+					ops.push_back(op);
+					demand[op.fu] += op.occupancy;
+					maxOccupancy = max(maxOccupancy, op.occupancy);
+				}
+
+				vector<unsigned int> degree(ops.size() + 1, 0);
+				for (unsigned int o = 0; o < ops.size(); o ++) {	//by producer, in node order
+					for (unsigned int k = graph.OutBegin(ops[o].node); k != graph.OutEnd(ops[o].node); k ++) {
+						const clust_edge& edge = graph.Edge(graph.OutEdge(k));
+						if (edge.removed || edge.depType >= MEMDEP_FLOW || opOf[edge.dst] == noOp) continue;	//memory dependences only order
+						map_edge value;
+						value.src = o;
+						value.dst = opOf[edge.dst];
+						value.distance = edge.distance;
+						edges.push_back(value);
+						degree[value.src + 1] ++;
+						if (value.dst != value.src) degree[value.dst + 1] ++;
+					}
+				}
+				for (unsigned int o = 0; o < ops.size(); o ++) degree[o + 1] += degree[o];
+				incidentStart = degree;
+				incident.resize(degree.back());
+				for (unsigned int e = 0; e < edges.size(); e ++) {
+					incident[degree[edges[e].src] ++] = e;
+					if (edges[e].dst != edges[e].src) incident[degree[edges[e].dst] ++] = e;
+				}
+			}
+
+			unsigned int NumOps() const { return ops.size(); }
+			const map_op& Op(unsigned int o) const { return ops[o]; }
+			unsigned int NumEdges() const { return edges.size(); }
+			const map_edge& Edge(unsigned int e) const { return edges[e]; }
+
+			// edges of operation o are Edge(Incident(k)) for k in [IncidentBegin(o), IncidentEnd(o))
+			unsigned int IncidentBegin(unsigned int o) const { return incidentStart[o]; }
+			unsigned int IncidentEnd(unsigned int o) const { return incidentStart[o + 1]; }
+			unsigned int Incident(unsigned int k) const { return incident[k]; }
+
+			int Unsupported() const {	//a class of the loop no PE runs, -1 if there is none
+				for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++) {
+					if (c == FU_NONE || !demand[c]) continue;
+					unsigned int pe = 0;
+					while (pe < grid.NumPEs() && !grid.Runs(pe, (fu_class)c)) pe ++;
+					if (pe == grid.NumPEs()) return c;
+				}
+				return -1;
+			}
+
+			// Gives every PE one class, so that each class has enough PEs for its
+			// operations at ii: a matching of PEs to the units the classes need,
+			// by augmenting paths. The PEs left over go to the classes with the
+			// most operations per PE. When there is no such matching, every class
+			// gets all PEs that run it as units and no PE has an owner: the
+			// placement then finds out whether they can share.
+			void Assign(unsigned int ii, vector<unsigned int>& owner, unsigned int units[NUM_FU_CLASSES]) const {
+				memset(units, 0, NUM_FU_CLASSES * sizeof(unsigned int));
+				owner.assign(grid.NumPEs(), FU_NONE);
+				vector<unsigned int> need;	//class of every unit needed
+				for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++)
+					if (c != FU_NONE) need.insert(need.end(), (demand[c] + ii - 1) / ii, c);
+				vector<int> unitOf(grid.NumPEs(), -1);
+				bool matched = need.size() <= grid.NumPEs();
+				for (unsigned int u = 0; matched && u < need.size(); u ++) {
+					vector<bool> seen(grid.NumPEs(), false);
+					matched = Augment(u, need, unitOf, seen);
+				}
+				if (!matched) {
+					for (unsigned int pe = 0; pe < grid.NumPEs(); pe ++)
+						for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++)
+							if (c != FU_NONE && grid.Runs(pe, (fu_class)c)) units[c] ++;
+					return;
+				}
+
+				for (unsigned int pe = 0; pe < grid.NumPEs(); pe ++) {
+					if (unitOf[pe] < 0) continue;
+					owner[pe] = need[unitOf[pe]];
+					units[owner[pe]] ++;
+				}
+				for (unsigned int pe = 0; pe < grid.NumPEs(); pe ++) {
+					if (unitOf[pe] >= 0) continue;
+					unsigned int best = FU_NONE;
+					for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++) {	//compare demand[c] / units[c]
+						if (c == FU_NONE || !demand[c] || !grid.Runs(pe, (fu_class)c)) continue;
+						if (best == FU_NONE || (unsigned long long)demand[c] * units[best] > (unsigned long long)demand[best] * units[c]) best = c;
+					}
+					owner[pe] = best;
+					if (best != FU_NONE) units[best] ++;
+				}
+			}
+
+			// For every set of classes, their PE cycles over the PEs that run any of
+			// them: Hall's condition for spreading the operations over the PE cycles.
+			unsigned int ResMII() const {
+				unsigned int resMII = max(maxOccupancy, 1U);
+				for (unsigned int set = 1; set < (1U << NUM_FU_CLASSES); set ++) {
+					unsigned int cycles = 0, pes = 0;
+					for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++)
+						if (c != FU_NONE && (set & (1 << c))) cycles += demand[c];
+					for (unsigned int pe = 0; cycles && pe < grid.NumPEs(); pe ++) {
+						unsigned int c = 0;
+						while (c < NUM_FU_CLASSES && (c == FU_NONE || !(set & (1 << c)) || !grid.Runs(pe, (fu_class)c))) c ++;
+						if (c < NUM_FU_CLASSES) pes ++;
+					}
+					if (cycles) resMII = max(resMII, (cycles + pes - 1) / pes);	//Unsupported() makes sure pes > 0
+				}
+				return resMII;
+			}
+
+		private:
+			const cgra_grid& grid;
+			vector<map_op> ops;
+			vector<map_edge> edges;
+			vector<unsigned int> incidentStart;
+			vector<unsigned int> incident;
+			unsigned int demand[NUM_FU_CLASSES];	//PE cycles of the operations of each class
+			unsigned int maxOccupancy;	//an operation does not leave its PE
+
+			bool Augment(unsigned int u, const vector<unsigned int>& need, vector<int>& unitOf, vector<bool>& seen) const {
+				for (unsigned int pe = 0; pe < grid.NumPEs(); pe ++) {
+					if (seen[pe] || !grid.Runs(pe, (fu_class)need[u])) continue;
+					seen[pe] = true;
+					if (unitOf[pe] < 0 || Augment(unitOf[pe], need, unitOf, seen)) {
+						unitOf[pe] = u;
+						return true;
+					}
+				}
+				return false;
+			}
+	};
+
+	typedef struct
+	{
+		unsigned int ii;
+		unsigned int transfer;
+		unsigned int stages;
+		vector<int> time;	//issue cycle of each operation
+		vector<unsigned int> owner;	//class of each PE, see map_problem::Assign
+		vector<int> slack;	//cycles each edge has for routing: from the result to the cycle it is read
+		unsigned int maxLive;	//values in registers at the busiest cycle mod II, at least
+	}map_plan;	//a schedule at one II, shared by its restarts
+
+	typedef struct
+	{
+		bool routed;
+		bool timedOut;
+		unsigned int links;	//link and register cycles used
+		unsigned int registers;
+		vector<unsigned int> pe;	//PE of each operation
+		vector<vector<unsigned int> > paths;	//of each edge, see map_route
+	}map_result;
+
+	class map_restart {	//placement by simulated annealing and routing, one restart
+		public:
+			map_restart(const map_problem& problem, const cgra_grid& grid, const map_plan& plan, uint64_t seed, double deadline)
+				: problem(problem), grid(grid), plan(plan), random(seed), deadline(deadline), steps(0), timedOut(false) {}
+
+			void Run(map_result& result) {
+				result.routed = false;
+				result.timedOut = false;
+				if (Place() && Anneal() && Route(result)) result.routed = true;
+				result.timedOut = timedOut;
+			}
+
+		private:
+			const map_problem& problem;
+			const cgra_grid& grid;
+			const map_plan& plan;
+			random_stream random;
+			double deadline;
+			unsigned long long steps;
+			bool timedOut;
+
+			vector<unsigned int> pe;	//of each operation
+			vector<unsigned int> table;	//operation on each PE in each cycle mod II
+
+			bool OutOfTime() {
+				if (deadline > 0 && ++ steps % clockSteps == 0 && Now() > deadline) timedOut = true;
+				return timedOut;
+			}
+
+			unsigned int& Cell(unsigned int cycle, unsigned int p) {
+				return table[(size_t)(cycle % plan.ii) * grid.NumPEs() + p];
+			}
+
+			bool Free(unsigned int o, unsigned int p, unsigned int ignore) {	//p has no operation but ignore in the cycles o holds it
+				const map_op& op = problem.Op(o);
+				for (unsigned int c = 0; c < op.occupancy; c ++) {
+					unsigned int other = Cell(plan.time[o] + c, p);
+					if (other != noOp && other != ignore) return false;
+				}
+				return true;
+			}
+
+			void Put(unsigned int o, unsigned int p, unsigned int what) {	//fill the cycles of o on p with what
+				for (unsigned int c = 0; c < problem.Op(o).occupancy; c ++) Cell(plan.time[o] + c, p) = what;
+			}
+
+			double EdgeCost(unsigned int e) const {	//hops, and a penalty for every hop the value has no cycle for
+				const map_edge& edge = problem.Edge(e);
+				unsigned int hops = grid.Hops(pe[edge.src], pe[edge.dst]);
+				if (hops == unreachable) return latePenalty * grid.NumPEs();
+				int late = (int)((hops > 1) ? hops - 1 : 0) - plan.slack[e];	//the last hop is the read
+				return hops + ((late > 0) ? latePenalty * late : 0);
+			}
+
+			double OpCost(unsigned int o, unsigned int other) const {	//edges of o and other, each once
+				double cost = 0;
+				for (unsigned int k = problem.IncidentBegin(o); k != problem.IncidentEnd(o); k ++) cost += EdgeCost(problem.Incident(k));
+				if (other == noOp) return cost;
+				for (unsigned int k = problem.IncidentBegin(other); k != problem.IncidentEnd(other); k ++) {
+					const map_edge& edge = problem.Edge(problem.Incident(k));
+					if (edge.src != o && edge.dst != o) cost += EdgeCost(problem.Incident(k));
+				}
+				return cost;
+			}
+
+			// Every operation goes to a PE of its class (PHIs to any PE) that is free in
+			// its cycles, the one closest to the operations placed before it.
+			bool Place() {
+				pe.assign(problem.NumOps(), 0);
+				table.assign((size_t)plan.ii * grid.NumPEs(), noOp);
+				vector<pair<int, unsigned int> > order;
+				for (unsigned int o = 0; o < problem.NumOps(); o ++) order.push_back(make_pair(plan.time[o], o));
+				std::sort(order.begin(), order.end());
+
+				vector<bool> placed(problem.NumOps(), false);
+				for (unsigned int i = 0; i < order.size(); i ++) {
+					unsigned int o = order[i].second;
+					const map_op& op = problem.Op(o);
+					unsigned int best = grid.NumPEs();
+					double bestCost = infinite;
+					for (unsigned int pass = 0; pass < 2 && best == grid.NumPEs(); pass ++) {	//a PE of its class first, then any that runs it
+						unsigned int first = random.Below(grid.NumPEs());	//ties go to the first PE from a random one
+						for (unsigned int k = 0; k < grid.NumPEs(); k ++) {
+							unsigned int p = (first + k) % grid.NumPEs();
+							if (!grid.Runs(p, op.fu) || (pass == 0 && op.fu != FU_NONE && plan.owner[p] != op.fu) || !Free(o, p, noOp)) continue;
+							pe[o] = p;
+							double cost = 0;
+							for (unsigned int j = problem.IncidentBegin(o); j != problem.IncidentEnd(o); j ++) {
+								const map_edge& edge = problem.Edge(problem.Incident(j));
+								if (placed[(edge.src == o) ? edge.dst : edge.src] || edge.src == edge.dst) cost += EdgeCost(problem.Incident(j));
+							}
+							if (cost < bestCost) {
+								bestCost = cost;
+								best = p;
+							}
+						}
+					}
+					if (best == grid.NumPEs()) return false;
+					pe[o] = best;
+					Put(o, best, o);
+					placed[o] = true;
+				}
+				return true;
+			}
+
+			// Picks an operation and another PE that runs it, free in its cycles or held
+			// in exactly those by one operation (other) that can take its place.
+			bool Propose(unsigned int& o, unsigned int& p, unsigned int& other) {
+				o = random.Below(problem.NumOps());
+				p = random.Below(grid.NumPEs());
+				const map_op& op = problem.Op(o);
+				if (p == pe[o] || !grid.Runs(p, op.fu)) return false;
+				other = noOp;
+				if (Free(o, p, noOp)) return true;
+				other = Cell(plan.time[o], p);
+				if (other == noOp) return false;
+				const map_op& swap = problem.Op(other);
+				return swap.occupancy == op.occupancy && plan.time[other] % plan.ii == plan.time[o] % plan.ii
+					&& grid.Runs(pe[o], swap.fu) && Free(o, p, other);
+			}
+
+			void Move(unsigned int o, unsigned int p, unsigned int other) {	//other goes to the PE of o; Move(o, from, other) takes it back
+				unsigned int from = pe[o];
+				Put(o, from, noOp);
+				if (other != noOp) {
+					Put(other, p, noOp);
+					pe[other] = from;
+					Put(other, from, other);
+				}
+				pe[o] = p;
+				Put(o, p, o);
+			}
+
+			bool Anneal() {
+				double cost = 0;
+				for (unsigned int e = 0; e < problem.NumEdges(); e ++) cost += EdgeCost(e);
+				vector<unsigned int> best = pe;
+				double bestCost = cost;
+				unsigned int moves = movesPerOp * problem.NumOps();
+
+				double temperature = 0;	//twice the average cost of a move that makes things worse
+				unsigned int worse = 0;
+				for (unsigned int m = 0; m < moves; m ++) {
+					unsigned int o, p, other;
+					if (!Propose(o, p, other)) continue;
+					double before = OpCost(o, other);
+					unsigned int from = pe[o];
+					Move(o, p, other);
+					double delta = OpCost(o, other) - before;
+					Move(o, from, other);
+					if (delta > 0) {
+						temperature += delta;
+						worse ++;
+					}
+				}
+				if (!worse || cost == 0) return true;	//nothing to gain
+				temperature = 2 * temperature / worse;
+
+				for (unsigned int round = 0; round < maxRounds && temperature > 0.01; round ++) {
+					unsigned int accepted = 0;
+					for (unsigned int m = 0; m < moves; m ++) {
+						if (OutOfTime()) return false;
+						unsigned int o, p, other;
+						if (!Propose(o, p, other)) continue;
+						double before = OpCost(o, other);
+						unsigned int from = pe[o];
+						Move(o, p, other);
+						double delta = OpCost(o, other) - before;
+						if (delta <= 0 || random.Unit() < exp(-delta / temperature)) {
+							cost += delta;
+							accepted ++;
+						}
+						else Move(o, from, other);
+					}
+					if (cost < bestCost) {
+						bestCost = cost;
+						best = pe;
+					}
+					if (!accepted) break;
+					temperature *= cooling;
+				}
+
+				pe = best;	//the table is not needed any more
+				return true;
+			}
+
+			// Routing resources: a register of each PE and each link, in every cycle mod
+			// II. A value that stays on a PE for a cycle takes one of its registers, one
+			// that moves takes the link and a register at the other end; the consumer
+			// reads it from its own PE or over a link from a neighbour.
+			unsigned int Register(unsigned int cycle, unsigned int p) const { return (cycle % plan.ii) * grid.NumPEs() + p; }
+			unsigned int LinkUse(unsigned int cycle, unsigned int k) const { return plan.ii * grid.NumPEs() + (cycle % plan.ii) * grid.NumLinks() + k; }
+			bool IsRegister(unsigned int r) const { return r < plan.ii * grid.NumPEs(); }
+
+			typedef map<pair<unsigned int, int>, unsigned int> held_map;	//resource and absolute cycle a value holds, with the routes that use it
+
+			double Cost(unsigned int r, int cycle, const held_map& held, const vector<unsigned int>& use, const vector<double>& history, double present) const {
+				if (held.count(make_pair(r, cycle))) return 0;	//shared with another consumer of the value
+				unsigned int capacity = IsRegister(r) ? grid.Registers() : 1;
+				double over = (use[r] + 1 > capacity) ? use[r] + 1 - capacity : 0;
+				return (1 + history[r]) * (1 + present * over);
+			}
+
+			void Hold(held_map& held, unsigned int r, int cycle, vector<unsigned int>& use, vector<pair<unsigned int, int> >& keys) {
+				if (held[make_pair(r, cycle)] ++ == 0) use[r] ++;
+				keys.push_back(make_pair(r, cycle));
+			}
+
+			// Cheapest path of edge e in time: one PE per cycle from the result to the read.
+			bool RoutePath(unsigned int e, held_map& held, vector<unsigned int>& use, const vector<double>& history, double present,
+					vector<unsigned int>& path, vector<pair<unsigned int, int> >& keys) {
+				const map_edge& edge = problem.Edge(e);
+				if (plan.slack[e] < 0) return false;
+				int ready = plan.time[edge.src] + problem.Op(edge.src).delay;
+				unsigned int length = plan.slack[e] + 1;
+				unsigned int nPEs = grid.NumPEs();
+				unsigned int target = pe[edge.dst];
+				vector<double> cost((size_t)length * nPEs, infinite);
+				vector<unsigned int> from((size_t)length * nPEs, 0);
+				cost[pe[edge.src]] = 0;
+				for (unsigned int c = 0; c + 1 < length; c ++) {
+					int cycle = ready + c + 1;
+					for (unsigned int p = 0; p < nPEs; p ++) {
+						double here = cost[(size_t)c * nPEs + p];
+						if (here >= infinite) continue;
+						unsigned int hops = grid.Hops(p, target);
+						if (hops == unreachable || (hops > 1 && hops - 1 > length - 1 - c)) continue;	//too far to make it
+						double stay = here + Cost(Register(cycle, p), cycle, held, use, history, present);
+						if (stay < cost[(size_t)(c + 1) * nPEs + p]) {
+							cost[(size_t)(c + 1) * nPEs + p] = stay;
+							from[(size_t)(c + 1) * nPEs + p] = p;
+						}
+						for (unsigned int k = grid.LinkBegin(p); k != grid.LinkEnd(p); k ++) {
+							unsigned int q = grid.Link(k).dst;
+							double move = here + Cost(LinkUse(cycle, k), cycle, held, use, history, present)
+								+ Cost(Register(cycle, q), cycle, held, use, history, present);
+							if (move < cost[(size_t)(c + 1) * nPEs + q]) {
+								cost[(size_t)(c + 1) * nPEs + q] = move;
+								from[(size_t)(c + 1) * nPEs + q] = p;
+							}
+						}
+					}
+				}
+
+				int read = ready + length - 1;
+				const double* last = &cost[(size_t)(length - 1) * nPEs];
+				unsigned int end = target;
+				double best = last[target];
+				for (unsigned int p = 0; p < nPEs; p ++) {	//or over a link into the consumer's PE
+					int k = grid.FindLink(p, target);
+					if (k < 0 || last[p] >= infinite) continue;
+					double over = last[p] + Cost(LinkUse(read, k), read, held, use, history, present);
+					if (over < best) {
+						best = over;
+						end = p;
+					}
+				}
+				if (best >= infinite) return false;
+
+				path.assign(length, 0);
+				path[length - 1] = end;
+				for (unsigned int c = length - 1; c > 0; c --) path[c - 1] = from[(size_t)c * nPEs + path[c]];
+				keys.clear();
+				for (unsigned int c = 1; c < length; c ++) {
+					int cycle = ready + c;
+					if (path[c] != path[c - 1]) Hold(held, LinkUse(cycle, grid.FindLink(path[c - 1], path[c])), cycle, use, keys);
+					Hold(held, Register(cycle, path[c]), cycle, use, keys);
+				}
+				if (end != target) Hold(held, LinkUse(read, grid.FindLink(end, target)), read, use, keys);
+				return true;
+			}
+
+			// Negotiated congestion: all values are routed, those that share a resource
+			// beyond its capacity make it dearer for the next round.
+			bool Route(map_result& result) {
+				unsigned int nResources = plan.ii * (grid.NumPEs() + grid.NumLinks());
+				vector<unsigned int> use(nResources, 0);
+				vector<double> history(nResources, 0);
+				vector<held_map> held(problem.NumOps());	//by producer
+				vector<vector<pair<unsigned int, int> > > keys(problem.NumEdges());
+				result.paths.assign(problem.NumEdges(), vector<unsigned int>());
+				double present = 1;
+				unsigned int leastOver = ~0U, leastRound = 0;	//the overuse stops going down, the II is too small
+
+				for (unsigned int round = 0; round < routeRounds && round - leastRound < routeStall; round ++) {
+					for (unsigned int e = 0; e < problem.NumEdges(); e ++) {
+						if (OutOfTime()) return false;
+						held_map& value = held[problem.Edge(e).src];
+						for (unsigned int k = 0; k < keys[e].size(); k ++)	//rip up
+							if (-- value[keys[e][k]] == 0) {
+								value.erase(keys[e][k]);
+								use[keys[e][k].first] --;
+							}
+						if (!RoutePath(e, value, use, history, present, result.paths[e], keys[e])) return false;
+					}
+
+					unsigned int over = 0;
+					for (unsigned int r = 0; r < nResources; r ++) {
+						unsigned int capacity = IsRegister(r) ? grid.Registers() : 1;
+						if (use[r] <= capacity) continue;
+						over += use[r] - capacity;
+						history[r] += use[r] - capacity;
+					}
+					if (!over) {
+						result.pe = pe;
+						result.links = result.registers = 0;
+						for (unsigned int r = 0; r < nResources; r ++) {
+							if (IsRegister(r)) result.registers += use[r];
+							else result.links += use[r];
+						}
+						return true;
+					}
+					if (over < leastOver) {
+						leastOver = over;
+						leastRound = round;
+					}
+					present *= 1.5;
+				}
+				return false;
+			}
+	};
+
+	class restart_job : public pool_job {	//the restarts at one II
+		public:
+			restart_job(const map_problem& problem, const cgra_grid& grid, const map_plan& plan, double deadline, vector<map_result>& results)
+				: problem(problem), grid(grid), plan(plan), deadline(deadline), results(results) {}
+			virtual void Run(unsigned int r) {
+				map_restart restart(problem, grid, plan, ((uint64_t)plan.ii << 32) + plan.transfer * 65536 + r, deadline);
+				restart.Run(results[r]);
+			}
+		private:
+			const map_problem& problem;
+			const cgra_grid& grid;
+			const map_plan& plan;
+			double deadline;
+			vector<map_result>& results;
+	};
+
+	// Modulo schedule at exactly ii, with the PEs split among the classes. False if
+	// the scheduler needs a larger II or ran out of time.
+	bool Plan(const clust_graph& graph, const map_problem& problem, unsigned int recMII, unsigned int ii, unsigned int transfer,
+			double deadline, map_plan& plan, bool& timedOut) {
+		schedule_config config;
+		problem.Assign(ii, plan.owner, config.units);
+		config.transfer = transfer;
+		config.budget = 0;
+		if (deadline > 0) {
+			config.budget = deadline - Now();
+			if (config.budget <= 0) {
+				timedOut = true;
+				return false;
+			}
+		}
+		modulo_scheduler scheduler(config);
+		loop_schedule schedule;
+		scheduler.Schedule(graph, recMII, ii, schedule);
+		timedOut = schedule.timedOut;
+		if (schedule.ii != ii) return false;
+
+		plan.ii = ii;
+		plan.transfer = transfer;
+		plan.stages = schedule.stages;
+		plan.time.resize(problem.NumOps());
+		for (unsigned int o = 0; o < problem.NumOps(); o ++) plan.time[o] = schedule.cycle[problem.Op(o).node];
+		plan.slack.resize(problem.NumEdges());
+		for (unsigned int e = 0; e < problem.NumEdges(); e ++) {
+			const map_edge& edge = problem.Edge(e);
+			plan.slack[e] = plan.time[edge.dst] + (int)(ii * edge.distance) - plan.time[edge.src] - (int)problem.Op(edge.src).delay;
+		}
+
+		// A value takes a register in every cycle after its result until its last read,
+		// whatever the routes: a bound no placement gets below.
+		vector<unsigned int> live(ii, 0);
+		vector<int> lastRead(problem.NumOps(), -1);
+		for (unsigned int e = 0; e < problem.NumEdges(); e ++)
+			lastRead[problem.Edge(e).src] = max(lastRead[problem.Edge(e).src], plan.slack[e]);
+		for (unsigned int o = 0; o < problem.NumOps(); o ++) {
+			if (lastRead[o] <= 0) continue;
+			unsigned int first = plan.time[o] + problem.Op(o).delay + 1;
+			for (unsigned int c = 0; c < ii; c ++) live[(first + c) % ii] += (lastRead[o] - c + ii - 1) / ii;	//cycles first + c + k * ii up to the last read
+		}
+		plan.maxLive = *max_element(live.begin(), live.end());
+		return true;
+	}
+
+	typedef enum {
+		MAP_FOUND,
+		MAP_NONE,
+		MAP_TIMEOUT
+	} map_status;
+
+	// All restarts at one II, for each of the cycles the schedule may add to every
+	// dependence in turn. Fills in the mapping of the II when one routes; leastLive
+	// is lowered to the live values of schedules the registers cannot hold.
+	map_status MapAt(const clust_graph& graph, const map_problem& problem, const cgra_grid& grid, const map_config& config,
+			unsigned int recMII, unsigned int ii, const vector<unsigned int>& transfers, double deadline, loop_mapping& mapping,
+			unsigned int& leastLive) {
+		for (unsigned int t = 0; t < transfers.size(); t ++) {
+			unsigned int transfer = transfers[t];
+			map_plan plan;
+			bool timedOut = false;
+			if (!Plan(graph, problem, recMII, ii, transfer, deadline, plan, timedOut)) {
+				if (timedOut) return MAP_TIMEOUT;
+				continue;
+			}
+			if (plan.maxLive > grid.NumPEs() * grid.Registers()) {
+				leastLive = min(leastLive, plan.maxLive);
+				continue;
+			}
+
+			vector<map_result> results(config.restarts);
+			restart_job job(problem, grid, plan, deadline, results);
+			RunWorkStealing(job, config.restarts, config.threads);
+
+			int best = -1;	//fewest routing resources, then the lowest restart
+			for (unsigned int r = 0; r < results.size(); r ++) {
+				if (results[r].timedOut) timedOut = true;
+				if (!results[r].routed) continue;
+				if (best < 0 || results[r].links + results[r].registers < results[best].links + results[best].registers) best = r;
+			}
+			if (timedOut) return MAP_TIMEOUT;	//a restart that was cut short might have won
+			if (best < 0) continue;
+
+			const map_result& result = results[best];
+			mapping.ii = ii;
+			mapping.stages = plan.stages;
+			mapping.transfer = transfer;
+			mapping.pe.assign(graph.NumNodes(), -1);
+			mapping.cycle.assign(graph.NumNodes(), -1);
+			mapping.routes.clear();
+			unsigned int busy = 0;
+			for (unsigned int o = 0; o < problem.NumOps(); o ++) {
+				const map_op& op = problem.Op(o);
+				mapping.pe[op.node] = result.pe[o];
+				mapping.cycle[op.node] = plan.time[o];
+				busy += op.occupancy;
+			}
+			for (unsigned int e = 0; e < problem.NumEdges(); e ++) {
+				const map_edge& edge = problem.Edge(e);
+				map_route route;
+				route.src = problem.Op(edge.src).node;
+				route.dst = problem.Op(edge.dst).node;
+				route.cycle = plan.time[edge.src] + problem.Op(edge.src).delay;
+				route.pes = result.paths[e];
+				mapping.routes.push_back(route);
+			}
+			mapping.fuUse = (double)busy / (ii * grid.NumPEs());
+			mapping.linkUse = grid.NumLinks() ? (double)result.links / (ii * grid.NumLinks()) : 0;
+			mapping.registerUse = grid.Registers() ? (double)result.registers / (ii * grid.NumPEs() * grid.Registers()) : 0;
+			return MAP_FOUND;
+		}
+		return MAP_NONE;
+	}
+}
+
+cgra_grid::cgra_grid() : columns(4), rows(4), registers(4), topology(TOPO_MESH) {
+	classes.assign(NumPEs(), (1 << FU_ALU) | (1 << FU_MUL) | (1 << FU_MEM) | (1 << FU_FP));
+	Connect();
+}
+
+bool cgra_grid::Load(const string& fileName, string& error) {
+	FILE* gf = fopen(fileName.c_str(), "r");
+	if (!gf) {
+		error = "cannot open " + fileName;
+		return false;
+	}
+
+	typedef struct
+	{
+		int column;	//-1 for all
+		int row;
+		unsigned int classes;
+		unsigned int lineNo;
+	}pe_line;
+	vector<pe_line> peLines;	//applied once the size is known
+
+	char line[512];
+	unsigned int lineNo = 0;
+	bool valid = true;
+	while (valid && fgets(line, sizeof(line), gf)) {
+		lineNo ++;
+		char* comment = strchr(line, '#');
+		if (comment) *comment = 0;
+
+		char keyword[16], a[16], b[16];
+		int n = sscanf(line, "%15s %15s %15s", keyword, a, b);
+		if (n <= 0) continue;	//empty or comment only
+
+		if (strcmp(keyword, "grid") == 0) {
+			unsigned int c = 0, r = 0;
+			valid = (n == 3) && ParseIndex(a, c) > 0 && ParseIndex(b, r) > 0 && c > 0 && r > 0 && c * r <= 1024;
+			columns = c;
+			rows = r;
+		}
+		else if (strcmp(keyword, "topology") == 0) {
+			unsigned int t = 0;
+			while (n >= 2 && t < NUM_TOPOLOGIES && strcmp(a, topologyNames[t]) != 0) t ++;
+			valid = (n == 2) && t < NUM_TOPOLOGIES;
+			topology = (cgra_topology)t;
+		}
+		else if (strcmp(keyword, "registers") == 0) {
+			valid = (n == 2) && ParseIndex(a, registers) > 0 && registers <= 1024;
+		}
+		else if (strcmp(keyword, "pe") == 0 && n == 3) {
+			pe_line pl;
+			unsigned int index = 0;
+			int c = ParseIndex(a, index);
+			pl.column = (c > 0) ? (int)index : -1;
+			int r = ParseIndex(b, index);
+			pl.row = (r > 0) ? (int)index : -1;
+			pl.classes = 0;
+			pl.lineNo = lineNo;
+			valid = c != 0 && r != 0;
+
+			char* rest = line;	//the class names behind column and row
+			for (unsigned int skip = 0; skip < 3; skip ++) {
+				rest += strspn(rest, " \t\r\n");
+				rest += strcspn(rest, " \t\r\n");
+			}
+			char name[16];
+			int used = 0;
+			while (valid && sscanf(rest, "%15s%n", name, &used) == 1) {
+				unsigned int fu = FU_NONE + 1;
+				while (fu < NUM_FU_CLASSES && strcmp(name, latency_model::FUName(fu)) != 0) fu ++;
+				valid = fu < NUM_FU_CLASSES;
+				pl.classes |= 1 << fu;
+				rest += used;
+			}
+			valid = valid && pl.classes;
+			peLines.push_back(pl);
+		}
+		else valid = false;
+	}
+	fclose(gf);
+
+	for (unsigned int l = 0; valid && l < peLines.size(); l ++) {
+		valid = (peLines[l].column < (int)columns) && (peLines[l].row < (int)rows);
+		lineNo = peLines[l].lineNo;
+	}
+	if (!valid) {
+		char where[32];
+		snprintf(where, sizeof(where), ":%u: ", lineNo);
+		error = fileName + where + "expected: grid columns rows, topology mesh|torus|diagonal|hop, registers n or pe column row class...";
+		return false;
+	}
+
+	classes.assign(NumPEs(), (1 << FU_ALU) | (1 << FU_MUL) | (1 << FU_MEM) | (1 << FU_FP));
+	for (unsigned int l = 0; l < peLines.size(); l ++)
+		for (unsigned int y = 0; y < rows; y ++)
+			for (unsigned int x = 0; x < columns; x ++)
+				if ((peLines[l].column < 0 || peLines[l].column == (int)x) && (peLines[l].row < 0 || peLines[l].row == (int)y))
+					classes[y * columns + x] = peLines[l].classes;
+	Connect();
+	return true;
+}
+
+void cgra_grid::Connect() {
+	static const int steps[][3] = {	//column and row offset, topology that adds it
+		{1, 0, TOPO_MESH}, {-1, 0, TOPO_MESH}, {0, 1, TOPO_MESH}, {0, -1, TOPO_MESH},
+		{1, 1, TOPO_DIAGONAL}, {1, -1, TOPO_DIAGONAL}, {-1, 1, TOPO_DIAGONAL}, {-1, -1, TOPO_DIAGONAL},
+		{2, 0, TOPO_HOP}, {-2, 0, TOPO_HOP}, {0, 2, TOPO_HOP}, {0, -2, TOPO_HOP}
+	};
+
+	links.clear();
+	linkStart.assign(1, 0);
+	for (unsigned int pe = 0; pe < NumPEs(); pe ++) {
+		int x = pe % columns, y = pe / columns;
+		for (unsigned int s = 0; s < sizeof(steps) / sizeof(steps[0]); s ++) {
+			if (steps[s][2] != TOPO_MESH && steps[s][2] != topology) continue;
+			int nx = x + steps[s][0], ny = y + steps[s][1];
+			if (topology == TOPO_TORUS) {
+				nx = (nx + columns) % columns;
+				ny = (ny + rows) % rows;
+			}
+			if (nx < 0 || ny < 0 || nx >= (int)columns || ny >= (int)rows) continue;
+			cgra_link link;
+			link.src = pe;
+			link.dst = ny * columns + nx;
+			if (link.dst == pe || FindLink(pe, link.dst) >= 0) continue;	//small tori wrap onto themselves
+			links.push_back(link);
+		}
+		linkStart.push_back(links.size());
+	}
+
+	hops.assign(NumPEs() * NumPEs(), unreachable);
+	vector<unsigned int> queue;
+	for (unsigned int src = 0; src < NumPEs(); src ++) {	//breadth-first from every PE
+		unsigned int* dist = &hops[src * NumPEs()];
+		dist[src] = 0;
+		queue.assign(1, src);
+		for (unsigned int i = 0; i < queue.size(); i ++)
+			for (unsigned int k = LinkBegin(queue[i]); k != LinkEnd(queue[i]); k ++)
+				if (dist[links[k].dst] == unreachable) {
+					dist[links[k].dst] = dist[queue[i]] + 1;
+					queue.push_back(links[k].dst);
+				}
+	}
+}
+
+int cgra_grid::FindLink(unsigned int src, unsigned int dst) const {
+	unsigned int end = (src + 1 < linkStart.size()) ? linkStart[src + 1] : links.size();	//also while the links are added
+	for (unsigned int k = linkStart[src]; k < end; k ++)
+		if (links[k].dst == dst) return k;
+	return -1;
+}
+
+uint64_t cgra_grid::Fingerprint() const {
+	vector<unsigned int> data;
+	data.push_back(columns);
+	data.push_back(rows);
+	data.push_back(registers);
+	data.push_back(topology);
+	data.insert(data.end(), classes.begin(), classes.end());
+	return HashBytes(&data[0], data.size() * sizeof(unsigned int));
+}
+
+const char* cgra_grid::TopologyName(unsigned int topology) {
+	return (topology < NUM_TOPOLOGIES) ? topologyNames[topology] : "mesh";
+}
+
+void cgra_mapper::Map(const clust_graph& graph, unsigned int recMII, loop_mapping& mapping) const {
+	map_problem problem(graph, grid);
+	mapping.resMII = 0;
+	mapping.recMII = recMII;
+	mapping.ii = 0;
+	mapping.stages = 0;
+	mapping.transfer = 0;
+	mapping.columns = grid.Columns();
+	mapping.rows = grid.Rows();
+	mapping.fuUse = mapping.linkUse = mapping.registerUse = 0;
+	mapping.timedOut = false;
+	mapping.error.clear();
+	mapping.pe.assign(graph.NumNodes(), -1);
+	mapping.cycle.assign(graph.NumNodes(), -1);
+	mapping.routes.clear();
+	if (!problem.NumOps()) return;
+
+	int missing = problem.Unsupported();
+	if (missing >= 0) {
+		mapping.error = string("no PE runs ") + latency_model::FUName(missing);
+		return;
+	}
+	mapping.resMII = problem.ResMII();
+
+	// The steps between the IIs tried double until one maps, then the IIs in the
+	// last step are bisected: failed is the largest II known not to map, found
+	// the smallest one that does.
+	double deadline = (config.budget > 0) ? Now() + config.budget : 0;
+	unsigned int minII = max(max(mapping.resMII, recMII), 1U);
+	unsigned int maxII = minII + problem.NumOps();
+	unsigned int failed = minII - 1, found = 0;
+	unsigned int leastLive = ~0U;
+	unsigned int maxTransfer = 0;	//hops across the grid, less the one into the consumer: every placement has the cycles
+	for (unsigned int src = 0; src < grid.NumPEs(); src ++)
+		for (unsigned int dst = 0; dst < grid.NumPEs(); dst ++)
+			if (grid.Hops(src, dst) != unreachable) maxTransfer = max(maxTransfer, grid.Hops(src, dst));
+	vector<unsigned int> transfers;	//0, 1, 2, 4 and so on, then maxTransfer
+	for (unsigned int transfer = 0; transfer + 1 < maxTransfer; transfer = transfer ? 2 * transfer : 1) transfers.push_back(transfer);
+	transfers.push_back((maxTransfer > 1) ? maxTransfer - 1 : 0);
+	unsigned int ii = minII, step = 1;
+	loop_mapping attempt = mapping;
+	while (true) {
+		map_status status = MapAt(graph, problem, grid, config, recMII, ii, transfers, deadline, attempt, leastLive);
+		if (status == MAP_TIMEOUT) {
+			mapping.timedOut = true;
+			return;
+		}
+		if (status == MAP_FOUND) {
+			found = ii;
+			mapping = attempt;
+		}
+		else failed = ii;
+
+		if (found) {
+			if (found - failed <= 1) return;
+			ii = failed + (found - failed) / 2;
+		}
+		else {
+			if (ii == maxII) break;
+			ii = min(ii + step, maxII);
+			step *= 2;
+		}
+	}
+	char error[128];
+	if (leastLive != ~0U) snprintf(error, sizeof(error), "no mapping up to II %u, %u values live at once for %u registers",
+			maxII, leastLive, grid.NumPEs() * grid.Registers());
+	else snprintf(error, sizeof(error), "no mapping up to II %u", maxII);
+	mapping.error = error;
+}
@@ -0,0 +1,170 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for cgra_map.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CGRA_MAP_H_
+#define _CGRA_MAP_H_ 1
+
+#include "loop_graph_analysis.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+typedef enum {
+	TOPO_MESH,	//links to the 4 neighbours
+	TOPO_TORUS,	//mesh with links around the edges
+	TOPO_DIAGONAL,	//mesh with links to the 4 diagonal neighbours as well
+	TOPO_HOP,	//mesh with links to the PEs two steps away in a row or column as well
+	NUM_TOPOLOGIES
+} cgra_topology;
+
+typedef struct
+{
+	unsigned int src;	//PEs, by index y * columns + x
+	unsigned int dst;
+}cgra_link;
+
+// A coarse grained reconfigurable array: a grid of processing elements (PEs),
+// each with one functional unit that runs operations of some classes, a register
+// file and links to other PEs. Without a file it is a 4x4 mesh of PEs that run
+// every class, with 4 registers each; Load() changes it line by line:
+//
+//	grid	8	4	# columns rows, at most 1024 PEs
+//	topology	torus	# mesh, torus, diagonal or hop
+//	registers	2	# registers per PE
+//	pe	*	*	ALU MUL	# column row classes, * for all; later lines override
+//	pe	0	*	ALU MEM
+//
+// A value goes over one link per cycle. A PE reads the results of its
+// neighbours (the PEs with a link to it) without delay, and keeps a value for
+// a later cycle in one of its registers.
+class cgra_grid
+{
+	public:
+		cgra_grid();	//the default grid
+
+		bool Load(const std::string& fileName, std::string& error);	//false with a message naming the line on failure
+
+		unsigned int Columns() const { return columns; }
+		unsigned int Rows() const { return rows; }
+		unsigned int NumPEs() const { return columns * rows; }
+		unsigned int Registers() const { return registers; }
+		cgra_topology Topology() const { return topology; }
+		bool Runs(unsigned int pe, fu_class fu) const { return fu == FU_NONE || (classes[pe] & (1 << fu)); }
+
+		// links leaving pe are Link(k) for k in [LinkBegin(pe), LinkEnd(pe))
+		unsigned int NumLinks() const { return links.size(); }
+		const cgra_link& Link(unsigned int k) const { return links[k]; }
+		unsigned int LinkBegin(unsigned int pe) const { return linkStart[pe]; }
+		unsigned int LinkEnd(unsigned int pe) const { return linkStart[pe + 1]; }
+		int FindLink(unsigned int src, unsigned int dst) const;	//-1 if there is none
+		unsigned int Hops(unsigned int src, unsigned int dst) const { return hops[src * NumPEs() + dst]; }	//~0U if unreachable
+
+		uint64_t Fingerprint() const;	//hash of the grid, part of the cache key
+		static const char* TopologyName(unsigned int topology);
+
+	private:
+		unsigned int columns;
+		unsigned int rows;
+		unsigned int registers;
+		cgra_topology topology;
+		std::vector<unsigned int> classes;	//per PE, bit fu for each class it runs
+		std::vector<cgra_link> links;	//by source PE
+		std::vector<unsigned int> linkStart;
+		std::vector<unsigned int> hops;	//shortest paths in links, between every pair of PEs
+
+		void Connect();	//links and hops from the topology
+};
+
+typedef struct
+{
+	unsigned int src;	//producer and consumer node, by index
+	unsigned int dst;
+	int cycle;	//the cycle the result of src is ready
+	std::vector<unsigned int> pes;	//PE holding the value in each cycle from then on; dst reads it in the last one
+}map_route;
+
+typedef struct
+{
+	unsigned int resMII;	//PE cycles of the operations over the PEs that run them, see cgra_mapper
+	unsigned int recMII;	//of the final graph
+	unsigned int ii;	//achieved initiation interval, 0 if the loop could not be mapped
+	unsigned int stages;
+	unsigned int transfer;	//cycles the schedule gave every value off the recurrences for routing
+	unsigned int columns;	//of the grid, PE p is in column p % columns and row p / columns
+	unsigned int rows;
+	double fuUse;	//share of the PE cycles running an operation
+	double linkUse;	//share of the link cycles carrying a value
+	double registerUse;	//share of the register cycles holding a value
+	bool timedOut;	//the budget ran out: there is no mapping, or a lower II was not tried
+	std::string error;	//why there is no mapping, empty if there is one or it timed out
+	std::vector<int> pe;	//PE of each node by index, -1 for nodes without one
+	std::vector<int> cycle;	//issue cycle of each node by index, -1 for nodes without one
+	std::vector<map_route> routes;	//by producer
+}loop_mapping;
+
+typedef struct
+{
+	unsigned int restarts;	//independent annealing runs for each II, the best one is kept
+	unsigned int threads;	//threads they run on
+	double budget;	//wall clock seconds the mapping of one loop may take, 0 for no limit
+}map_config;
+
+// Maps the final loop graph onto a cgra_grid: every live instruction node gets a
+// PE and an issue cycle, and every data and control dependence between two of
+// them a route. Memory dependences and data nodes (live-ins, constants) need no
+// route. PHIs need no functional unit, only a PE to keep their value in.
+//
+// ResMII is the largest ratio of the PE cycles of a set of classes to the PEs
+// that run any of them. At an II the operations are modulo scheduled
+// (modulo_schedule.h) with every PE given to one class where the PEs allow it,
+// first with no extra cycles for routing, then with 1, 2, 4 and so on added to
+// every value off the recurrences, up to what it takes to cross the grid. A
+// schedule with more values live at once than the grid has registers is dropped.
+// Each restart places the operations by simulated annealing: it starts from the
+// PEs of their class and moves or swaps them to any PE that runs them, free in
+// their cycles, against the hops the values must travel in the cycles they have.
+// The edges are then routed over the PEs and links of every cycle mod II with
+// negotiated congestion (PathFinder): a value moves one link per cycle and takes
+// a register of the PE it is in. The IIs tried go up from max(ResMII, RecMII) in
+// doubling steps until one maps, then the last step is bisected. Of the restarts
+// of an II the one that routes with the fewest resources is kept, so the result
+// does not depend on the number of threads. One instance serves all threads.
+class cgra_mapper
+{
+	public:
+		cgra_mapper(const cgra_grid& grid, const map_config& config) : grid(grid), config(config) {}
+
+		void Map(const clust_graph& graph, unsigned int recMII, loop_mapping& mapping) const;	//the graph is finalized, with the SCCs of FindRecurrences()
+		const cgra_grid& Grid() const { return grid; }
+		const map_config& Config() const { return config; }
+
+	private:
+		cgra_grid grid;
+		map_config config;
+};
+
+#endif //_CGRA_MAP_H_
@@ -0,0 +1,420 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the compact loop graph (clust_graph) used by all phases.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "loop_graph_analysis.h"
+
+using namespace llvm;
+using namespace std;
+
+clust_graph::clust_graph() : csrValid(true), nRemovedNodes(0), nRemovedEdges(0), nSCCs(0), nAllocations(0) {
+	outStart.push_back(0);
+	inStart.push_back(0);
+	idIndex.push_back(-1);	//ids start at 1
+}
+
+void clust_graph::Reserve(unsigned int nNodes, unsigned int nEdges) {
+	CountGrowth(nodes, nNodes);
+	nodes.reserve(nNodes);
+	CountGrowth(edges, nEdges);
+	edges.reserve(nEdges);
+	CountGrowth(outStart, nNodes + 1);
+	outStart.reserve(nNodes + 1);
+	CountGrowth(inStart, nNodes + 1);
+	inStart.reserve(nNodes + 1);
+	CountGrowth(outList, nEdges);
+	outList.reserve(nEdges);
+	CountGrowth(inList, nEdges);
+	inList.reserve(nEdges);
+	CountGrowth(idIndex, nNodes + 1);
+	idIndex.reserve(nNodes + 1);
+
+	size_t before = nodeIndex.getMemorySize();	//DenseMaps grow at 3/4 load
+	nodeIndex.resize(nNodes * 4 / 3 + 1);
+	if (nodeIndex.getMemorySize() != before) nAllocations ++;
+	before = edgeCount.getMemorySize();
+	edgeCount.resize(nEdges * 4 / 3 + 1);
+	if (edgeCount.getMemorySize() != before) nAllocations ++;
+}
+
+unsigned int clust_graph::AddNode(Value* ins, bool keyed) {
+
+	clust_node newNode;
+	newNode.ins = ins;
+	newNode.id = 0;
+	newNode.entryNode = false;
+	newNode.ifAny = false;
+	newNode.wt = 0;
+	newNode.nodeType = INSTNODE;
+	newNode.depth = 0;
+	newNode.slack = 0;
+	newNode.latency = 1;
+	newNode.ii = 1;
+	newNode.fu = FU_ALU;
+	newNode.type = 'N';
+	newNode.isLoad = false;
+	newNode.visited = false;
+	newNode.nBackEdgesIn = 0;
+	newNode.nBackEdgesOut = 0;
+	newNode.scc = 0;
+	newNode.removed = false;
+	newNode.gepNode = false;
+	newNode.gepNodeType = GEP_ADD1;
+	newNode.gepImm = 0;
+	newNode.access = 0;
+	newNode.label = 0;
+	newNode.imm = 0;
+
+	unsigned int n = nodes.size();
+	CountGrowth(nodes, n + 1);
+	nodes.push_back(newNode);
+
+	if (keyed) {
+		assert (nodeIndex.find(ins) == nodeIndex.end());
+		size_t before = nodeIndex.getMemorySize();
+		nodeIndex[ins] = n;
+		if (nodeIndex.getMemorySize() != before) nAllocations ++;
+	}
+
+	CountGrowth(outStart, n + 2);
+	outStart.push_back(outStart.back());	//the new node has no edges yet
+	CountGrowth(inStart, n + 2);
+	inStart.push_back(inStart.back());
+	return n;
+}
+
+unsigned int clust_graph::AddEdge(unsigned int src, unsigned int dst, clust_dep depType, double wt, unsigned int id) {
+	assert (src < nodes.size() && dst < nodes.size());
+
+	clust_edge newEdge;
+	newEdge.src = src;
+	newEdge.dst = dst;
+	newEdge.depType = depType;
+	newEdge.wt = wt;
+	newEdge.id = id;
+	newEdge.distance = 0;
+	newEdge.unknownDistance = false;
+	newEdge.backEdge = false;
+	newEdge.removed = false;
+
+	CountGrowth(edges, edges.size() + 1);
+	edges.push_back(newEdge);
+	size_t before = edgeCount.getMemorySize();
+	edgeCount[make_pair(src, dst)] ++;
+	if (edgeCount.getMemorySize() != before) nAllocations ++;
+	csrValid = false;
+	return edges.size() - 1;
+}
+
+void clust_graph::SetNodeID(unsigned int n, unsigned int id) {
+	if (id >= idIndex.size()) {
+		CountGrowth(idIndex, id + 1);
+		idIndex.resize(id + 1, -1);
+	}
+	assert (idIndex[id] < 0);
+	if (nodes[n].id < idIndex.size() && idIndex[nodes[n].id] == (int)n) idIndex[nodes[n].id] = -1;
+	nodes[n].id = id;
+	idIndex[id] = n;
+}
+
+void clust_graph::RemoveEdge(unsigned int e) {
+	if (edges[e].removed) return;
+	edges[e].removed = true;
+	nRemovedEdges ++;
+	edgeCount[make_pair(edges[e].src, edges[e].dst)] --;
+}
+
+void clust_graph::RemoveNode(unsigned int n) {
+	assert (csrValid);
+	if (nodes[n].removed) return;
+
+	for (unsigned int k = OutBegin(n); k != OutEnd(n); k ++)	//outgoing edges
+		RemoveEdge(OutEdge(k));
+	for (unsigned int k = InBegin(n); k != InEnd(n); k ++)	//incoming edges
+		RemoveEdge(InEdge(k));
+
+	nodes[n].removed = true;
+	nRemovedNodes ++;
+	if (nodes[n].id < idIndex.size() && idIndex[nodes[n].id] == (int)n) idIndex[nodes[n].id] = -1;
+}
+
+void clust_graph::Finalize() {
+	if (csrValid) return;
+
+	unsigned int nNodes = nodes.size();
+	unsigned int nEdges = edges.size();
+
+	outStart.assign(nNodes + 1, 0);	//count edges per node
+	inStart.assign(nNodes + 1, 0);
+	for (unsigned int e = 0; e < nEdges; e ++) {
+		outStart[edges[e].src + 1] ++;
+		inStart[edges[e].dst + 1] ++;
+	}
+
+	for (unsigned int n = 0; n < nNodes; n ++) {	//prefix sums give row offsets
+		outStart[n + 1] += outStart[n];
+		inStart[n + 1] += inStart[n];
+	}
+
+	CountGrowth(outList, nEdges);
+	outList.resize(nEdges);
+	CountGrowth(inList, nEdges);
+	inList.resize(nEdges);
+
+	// scatter edges in insertion order so every row stays stable; the start of each
+	// row serves as its insert position and ends up at the start of the next row
+	for (unsigned int e = 0; e < nEdges; e ++) {
+		outList[outStart[edges[e].src] ++] = e;
+		inList[inStart[edges[e].dst] ++] = e;
+	}
+	for (unsigned int n = nNodes; n > 0; n --) {	//shift the rows back into place
+		outStart[n] = outStart[n - 1];
+		inStart[n] = inStart[n - 1];
+	}
+	outStart[0] = 0;
+	inStart[0] = 0;
+
+	csrValid = true;
+}
+
+int clust_graph::Find(Value* ins) const {
+	DenseMap<Value*, unsigned int>::const_iterator it = nodeIndex.find(ins);
+	if (it == nodeIndex.end()) return -1;
+	return it->second;
+}
+
+int clust_graph::NodeOfID(unsigned int id) const {
+	if (id >= idIndex.size()) return -1;
+	return idIndex[id];
+}
+
+bool clust_graph::HasEdge(unsigned int src, unsigned int dst) const {
+	DenseMap<pair<unsigned int, unsigned int>, unsigned int>::const_iterator it = edgeCount.find(make_pair(src, dst));
+	return (it != edgeCount.end()) && (it->second != 0);
+}
+
+unsigned int clust_graph::FindRecurrences() {
+	assert (csrValid);
+
+	unsigned int nBackEdges = 0;
+	for (unsigned int e = 0; e < edges.size(); e ++) {	//the loop-carried edges close the cycles
+		clust_edge& edge = edges[e];
+		if (edge.removed) continue;	//keeps its mark, the .graph file shows the graph before GEP expansion
+		edge.backEdge = (edge.distance > 0);
+		if (!edge.backEdge) continue;
+		nBackEdges ++;
+		nodes[edge.src].nBackEdgesOut ++;
+		nodes[edge.dst].nBackEdgesIn ++;
+	}
+
+	// Iterative Tarjan search from every node in index order. The explicit DFS path
+	// replaces recursion, the low-links give the SCCs in one O(V+E) pass.
+	unsigned int nNodes = nodes.size();
+	vector<unsigned int> index(nNodes, 0);
+	vector<unsigned int> low(nNodes, 0);
+	BitVector onStack(nNodes);
+	vector<unsigned int> sccStack;
+	vector<pair<unsigned int, unsigned int> > path;	//node and its next CSR position
+	unsigned int nextIndex = 1;
+	nSCCs = 0;
+
+	for (unsigned int root = 0; root < nNodes; root ++) {
+		if (nodes[root].visited) continue;
+
+		nodes[root].visited = true;	//init stack
+		index[root] = low[root] = nextIndex ++;
+		onStack.set(root);
+		sccStack.push_back(root);
+		path.push_back(make_pair(root, OutBegin(root)));
+
+		while (!path.empty()) {
+			unsigned int topNode = path.back().first;
+
+			if (path.back().second != OutEnd(topNode)) {	//process next child
+				const clust_edge& edge = edges[OutEdge(path.back().second ++)];
+				if (edge.removed) continue;
+				unsigned int child = edge.dst;
+
+				if (!nodes[child].visited) {	//push child
+					nodes[child].visited = true;
+					index[child] = low[child] = nextIndex ++;
+					onStack.set(child);
+					sccStack.push_back(child);
+					path.push_back(make_pair(child, OutBegin(child)));
+					continue;
+				}
+
+				if (onStack.test(child) && index[child] < low[topNode]) low[topNode] = index[child];
+				continue;
+			}
+
+			path.pop_back();	//all children done
+			if (!path.empty() && low[topNode] < low[path.back().first]) low[path.back().first] = low[topNode];
+
+			if (low[topNode] == index[topNode]) {	//topNode is the root of an SCC
+				unsigned int member;
+				do {
+					member = sccStack.back();
+					sccStack.pop_back();
+					onStack.reset(member);
+					nodes[member].scc = nSCCs;
+				} while (member != topNode);
+				nSCCs ++;
+			}
+		}//DFS
+	}
+	return nBackEdges;
+}
+
+unsigned int clust_graph::RecMII() const {
+	assert (csrValid);
+
+	vector<unsigned int> sccStart(nSCCs + 2, 0);	//members of SCC s are members[sccStart[s], sccStart[s + 1])
+	for (unsigned int n = 0; n < nodes.size(); n ++)
+		if (!nodes[n].removed) sccStart[nodes[n].scc + 2] ++;
+	for (unsigned int s = 2; s < sccStart.size(); s ++) sccStart[s] += sccStart[s - 1];
+	vector<unsigned int> members(sccStart.back());
+	for (unsigned int n = 0; n < nodes.size(); n ++)
+		if (!nodes[n].removed) members[sccStart[nodes[n].scc + 1] ++] = n;
+
+	unsigned int recMII = 0;
+	vector<long long> start(nodes.size(), 0);
+	vector<unsigned int> scc;
+	for (unsigned int s = 0; s < nSCCs; s ++) {
+		scc.assign(members.begin() + sccStart[s], members.begin() + sccStart[s + 1]);
+
+		unsigned int maxII = 0;	//every cycle has distance 1 or more, so the sum of the latencies always fits
+		bool recurrence = false;
+		for (unsigned int m = 0; m < scc.size(); m ++) {
+			maxII += Latency(scc[m]);
+			for (unsigned int k = OutBegin(scc[m]); k != OutEnd(scc[m]) && !recurrence; k ++) {
+				const clust_edge& edge = edges[OutEdge(k)];
+				recurrence = !edge.removed && (nodes[edge.dst].scc == s);
+			}
+		}
+		if (!recurrence || maxII <= recMII || RecurrenceFits(scc, recMII, start)) continue;
+
+		unsigned int lo = recMII;	//does not fit, maxII does
+		while (maxII - lo > 1) {
+			unsigned int mid = lo + (maxII - lo) / 2;
+			if (RecurrenceFits(scc, mid, start)) maxII = mid;
+			else lo = mid;
+		}
+		recMII = maxII;
+	}
+	return recMII;
+}
+
+// Can the nodes of an SCC start every ii cycles? Only if no cycle has a positive sum of
+// latency - ii * distance over its edges, checked with Bellman-Ford for longest paths.
+bool clust_graph::RecurrenceFits(const vector<unsigned int>& members, unsigned int ii, vector<long long>& start) const {
+	unsigned int scc = nodes[members[0]].scc;
+	for (unsigned int m = 0; m < members.size(); m ++) start[members[m]] = 0;
+
+	for (unsigned int round = 0; round < members.size(); round ++) {
+		bool changed = false;
+		for (unsigned int m = 0; m < members.size(); m ++) {
+			unsigned int n = members[m];
+			for (unsigned int k = OutBegin(n); k != OutEnd(n); k ++) {
+				const clust_edge& edge = edges[OutEdge(k)];
+				if (edge.removed || nodes[edge.dst].scc != scc) continue;
+				long long earliest = start[n] + Latency(n) - (long long)ii * edge.distance;
+				if (earliest > start[edge.dst]) {
+					start[edge.dst] = earliest;
+					changed = true;
+				}
+			}
+		}
+		if (!changed) return true;
+	}
+	return false;	//still growing after |members| rounds: a positive cycle
+}
+
+unsigned int clust_graph::Levelize() {
+	assert (csrValid);
+
+	unsigned int nNodes = nodes.size();
+	vector<unsigned int> pending(nNodes, 0);	//producers not levelled yet
+	for (unsigned int e = 0; e < edges.size(); e ++)
+		if (!edges[e].removed && !edges[e].backEdge) pending[edges[e].dst] ++;
+
+	vector<unsigned int> order;	//topological order, Kahn
+	order.reserve(nNodes - nRemovedNodes);
+	for (unsigned int n = 0; n < nNodes; n ++) {
+		if (nodes[n].removed) continue;
+		nodes[n].depth = 0;
+		if (pending[n] == 0) order.push_back(n);
+	}
+
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < order.size(); i ++) {	//ASAP: a node starts when its last producer is done
+		unsigned int n = order[i];
+		unsigned int finish = nodes[n].depth + Latency(n);
+		if (finish > length) length = finish;
+		for (unsigned int k = OutBegin(n); k != OutEnd(n); k ++) {
+			const clust_edge& edge = edges[OutEdge(k)];
+			if (edge.removed || edge.backEdge) continue;
+			if (finish > nodes[edge.dst].depth) nodes[edge.dst].depth = finish;
+			if (-- pending[edge.dst] == 0) order.push_back(edge.dst);
+		}
+	}
+	assert (order.size() == NumLiveNodes());	//no cycle is left once the back-edges are marked
+
+	vector<unsigned int> alap(nNodes, 0);	//ALAP: a node starts so that its first consumer can start in time
+	for (unsigned int i = order.size(); i -- > 0; ) {
+		unsigned int n = order[i];
+		unsigned int latest = length - Latency(n);
+		for (unsigned int k = OutBegin(n); k != OutEnd(n); k ++) {
+			const clust_edge& edge = edges[OutEdge(k)];
+			if (edge.removed || edge.backEdge) continue;
+			if (alap[edge.dst] - Latency(n) < latest) latest = alap[edge.dst] - Latency(n);
+		}
+		alap[n] = latest;
+		nodes[n].slack = latest - nodes[n].depth;
+	}
+	return length;
+}
+
+size_t clust_graph::MemoryBytes() const {
+	return nodes.capacity() * sizeof(clust_node) + edges.capacity() * sizeof(clust_edge)
+		+ (outStart.capacity() + outList.capacity() + inStart.capacity() + inList.capacity()) * sizeof(unsigned int)
+		+ idIndex.capacity() * sizeof(int) + nodeIndex.getMemorySize() + edgeCount.getMemorySize();
+}
+
+unsigned int clust_graph::OutDegree(unsigned int n) const {
+	unsigned int deg = 0;
+	for (unsigned int k = OutBegin(n); k != OutEnd(n); k ++)
+		if (!edges[OutEdge(k)].removed) deg ++;
+	return deg;
+}
+
+unsigned int clust_graph::InDegree(unsigned int n) const {
+	unsigned int deg = 0;
+	for (unsigned int k = InBegin(n); k != InEnd(n); k ++)
+		if (!edges[InEdge(k)].removed) deg ++;
+	return deg;
+}
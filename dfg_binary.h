@@ -0,0 +1,275 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file defines the binary loop graph format and a header-only reader for it.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DFG_BINARY_H_
+#define _DFG_BINARY_H_ 1
+
+// Binary form of the .loop_analysis_graph.graph file (.loop_analysis_graph.dfgb).
+// It holds the same graph as the text file: one record per node in id order and
+// the edges of each node as CSR rows in both directions. Back-edges (the
+// loop-carried recurrence edges) are in the rows with DFGB_BACKEDGE set; the
+// text format lists them after the nodes. Loads and stores with an affine
+// address (-dfg-affine) have a dfgb_access record; its base address and the
+// trip count of the loop are NUL terminated strings as printed by
+// ScalarEvolution. The layout is
+//
+//	dfgb_header
+//	dfgb_node	nodes[nNodes]
+//	uint32_t	outStart[nNodes + 1]	out-edges of node i are outEdges[outStart[i] .. outStart[i+1])
+//	dfgb_edge	outEdges[nEdges]
+//	uint32_t	inStart[nNodes + 1]
+//	dfgb_edge	inEdges[nEdges]
+//	dfgb_access	accesses[nAccesses]	in node order
+//	char	strings[stringBytes]
+//
+// with every section starting on an 8 byte boundary at the offset given in the
+// header. Numbers are in the byte order of the writing machine; readers check
+// byteOrder and refuse files from a machine of the other order. This header does
+// not depend on LLVM so that the tools reading the graphs can include it.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DFGB_VERSION 4
+#define DFGB_BYTE_ORDER 0x01020304
+#define DFGB_BACKEDGE 0x1	//dfgb_edge.flags: edge closes a cycle
+#define DFGB_UNKNOWN_DISTANCE 0xffff	//dfgb_edge.distance of a memory dependence carried by an unknown number of iterations
+
+typedef struct
+{
+	char magic[4];	//"DFGB"
+	uint32_t version;
+	uint32_t byteOrder;	//DFGB_BYTE_ORDER as stored by the writer
+	uint32_t loopID;
+	uint32_t nNodes;
+	uint32_t nEdges;	//edges in each direction, back-edges included
+	uint32_t maxDepth;	//critical path length in cycles
+	uint32_t recMII;	//recurrence-constrained minimum initiation interval, 0 without recurrences
+	uint32_t nAccesses;	//loads and stores with an affine address
+	uint32_t stringBytes;
+	uint32_t tripCount;	//offset of the trip count in the strings, ? if unknown; only if nAccesses > 0
+	uint32_t reserved;
+	double cov;	//coverage of the loop
+	uint64_t nodeOffset;	//byte offsets of the sections from the start of the file
+	uint64_t outStartOffset;
+	uint64_t outEdgeOffset;
+	uint64_t inStartOffset;
+	uint64_t inEdgeOffset;
+	uint64_t accessOffset;
+	uint64_t stringOffset;
+	uint64_t fileSize;
+}dfgb_header;
+
+typedef struct
+{
+	uint32_t id;
+	uint32_t depth;	//ASAP level
+	double wt;	//no of times the operation executes
+	int32_t latency;	//-1 if unknown, e.g. converted from text
+	char kind;	//C compute, M memory, D data
+	char type;	//N integer, F floating point, V vector
+	uint8_t ii;	//initiation interval, 0 if unknown
+	uint8_t fu;	//functional unit class, see fu_class in loop_graph_analysis.h
+	uint32_t slack;	//ALAP - ASAP level
+	uint32_t reserved2;
+}dfgb_node;
+
+typedef struct
+{
+	uint32_t node;	//record index of the node at the other end
+	char dep;	//D data, Y/N control dependence on the taken/not taken successor, F/A/O flow/anti/output memory dependence
+	uint8_t flags;	//DFGB_BACKEDGE
+	uint16_t distance;	//iterations from producer to consumer, 0 within an iteration
+}dfgb_edge;
+
+typedef struct
+{
+	uint32_t node;	//record index of the load or store, its address operand has no edge
+	uint32_t base;	//offset of the address in the first iteration in the strings
+	int64_t stride;	//bytes the address moves per iteration
+}dfgb_access;
+
+static inline uint64_t dfgb_Align(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t)7;
+}
+
+// fill in magic, version and the section offsets for the counts
+static inline void dfgb_InitHeader(dfgb_header& header, uint32_t loopID, uint32_t nNodes, uint32_t nEdges, uint32_t maxDepth, double cov,
+		uint32_t nAccesses, uint32_t stringBytes) {
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "DFGB", 4);
+	header.version = DFGB_VERSION;
+	header.byteOrder = DFGB_BYTE_ORDER;
+	header.loopID = loopID;
+	header.nNodes = nNodes;
+	header.nEdges = nEdges;
+	header.maxDepth = maxDepth;
+	header.nAccesses = nAccesses;
+	header.stringBytes = stringBytes;
+	header.cov = cov;
+
+	uint64_t startBytes = (uint64_t)(nNodes + 1) * sizeof(uint32_t);
+	uint64_t edgeBytes = (uint64_t)nEdges * sizeof(dfgb_edge);
+	header.nodeOffset = dfgb_Align(sizeof(dfgb_header));
+	header.outStartOffset = dfgb_Align(header.nodeOffset + (uint64_t)nNodes * sizeof(dfgb_node));
+	header.outEdgeOffset = dfgb_Align(header.outStartOffset + startBytes);
+	header.inStartOffset = dfgb_Align(header.outEdgeOffset + edgeBytes);
+	header.inEdgeOffset = dfgb_Align(header.inStartOffset + startBytes);
+	header.accessOffset = dfgb_Align(header.inEdgeOffset + edgeBytes);
+	header.stringOffset = dfgb_Align(header.accessOffset + (uint64_t)nAccesses * sizeof(dfgb_access));
+	header.fileSize = dfgb_Align(header.stringOffset + stringBytes);
+}
+
+static inline bool dfgb_WriteAt(FILE* f, uint64_t& pos, uint64_t offset, const void* data, uint64_t bytes) {
+	static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	if (offset > pos && fwrite(zeros, 1, offset - pos, f) != offset - pos) return false;	//padding
+	pos = offset + bytes;
+	return bytes == 0 || fwrite(data, 1, bytes, f) == bytes;
+}
+
+// write a whole file, header must come from dfgb_InitHeader
+static inline bool dfgb_Write(FILE* f, const dfgb_header& header, const dfgb_node* nodes,
+		const uint32_t* outStart, const dfgb_edge* outEdges, const uint32_t* inStart, const dfgb_edge* inEdges,
+		const dfgb_access* accesses, const char* strings) {
+	uint64_t startBytes = (uint64_t)(header.nNodes + 1) * sizeof(uint32_t);
+	uint64_t edgeBytes = (uint64_t)header.nEdges * sizeof(dfgb_edge);
+	uint64_t pos = 0;
+
+	return dfgb_WriteAt(f, pos, 0, &header, sizeof(header))
+		&& dfgb_WriteAt(f, pos, header.nodeOffset, nodes, (uint64_t)header.nNodes * sizeof(dfgb_node))
+		&& dfgb_WriteAt(f, pos, header.outStartOffset, outStart, startBytes)
+		&& dfgb_WriteAt(f, pos, header.outEdgeOffset, outEdges, edgeBytes)
+		&& dfgb_WriteAt(f, pos, header.inStartOffset, inStart, startBytes)
+		&& dfgb_WriteAt(f, pos, header.inEdgeOffset, inEdges, edgeBytes)
+		&& dfgb_WriteAt(f, pos, header.accessOffset, accesses, (uint64_t)header.nAccesses * sizeof(dfgb_access))
+		&& dfgb_WriteAt(f, pos, header.stringOffset, strings, header.stringBytes)
+		&& dfgb_WriteAt(f, pos, header.fileSize, 0, 0);
+}
+
+// Maps a .dfgb file read-only and gives direct access to its arrays; nothing is
+// copied, the pointers stay valid until Close() or destruction.
+class dfgb_reader
+{
+	public:
+		dfgb_reader() : base(0), size(0), error("no file") {}
+		~dfgb_reader() { Close(); }
+
+		bool Open(const char* path) {	//false on failure, Error() says why
+			Close();
+			int fd = open(path, O_RDONLY);
+			if (fd < 0) return Fail("cannot open file");
+
+			struct stat st;
+			if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(dfgb_header)) {
+				close(fd);
+				return Fail("file too short");
+			}
+
+			void* map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);	//the mapping keeps the file alive
+			if (map == MAP_FAILED) return Fail("cannot map file");
+			base = (const char*)map;
+			size = st.st_size;
+
+			const dfgb_header& header = Header();
+			if (memcmp(header.magic, "DFGB", 4) != 0) return Fail("not a DFGB file");
+			if (header.byteOrder != DFGB_BYTE_ORDER) return Fail("file has the other byte order");
+			if (header.version != DFGB_VERSION) return Fail("unsupported version");
+
+			dfgb_header expected;	//the offsets follow from the counts
+			dfgb_InitHeader(expected, header.loopID, header.nNodes, header.nEdges, header.maxDepth, header.cov,
+					header.nAccesses, header.stringBytes);
+			if (header.nodeOffset != expected.nodeOffset || header.outStartOffset != expected.outStartOffset
+					|| header.outEdgeOffset != expected.outEdgeOffset || header.inStartOffset != expected.inStartOffset
+					|| header.inEdgeOffset != expected.inEdgeOffset || header.accessOffset != expected.accessOffset
+					|| header.stringOffset != expected.stringOffset || header.fileSize != expected.fileSize
+					|| header.fileSize != size) return Fail("corrupt section offsets");
+			if (!ValidEdges(OutStart(), OutEdges()) || !ValidEdges(InStart(), InEdges())) return Fail("corrupt edge arrays");
+			if (header.stringBytes > 0 && Strings()[header.stringBytes - 1] != 0) return Fail("corrupt strings");
+			if (header.nAccesses > 0 && header.tripCount >= header.stringBytes) return Fail("corrupt trip count");
+			for (uint32_t a = 0; a < header.nAccesses; a ++)
+				if (Accesses()[a].node >= header.nNodes || Accesses()[a].base >= header.stringBytes) return Fail("corrupt accesses");
+
+			error = 0;
+			return true;
+		}
+
+		void Close() {
+			if (base) munmap((void*)base, size);
+			base = 0;
+			size = 0;
+			error = "no file";
+		}
+
+		const char* Error() const { return error; }	//0 if the file is open
+
+		const dfgb_header& Header() const { return *(const dfgb_header*)base; }
+		uint32_t NumNodes() const { return Header().nNodes; }
+		uint32_t NumEdges() const { return Header().nEdges; }
+
+		const dfgb_node* Nodes() const { return (const dfgb_node*)(base + Header().nodeOffset); }
+		const uint32_t* OutStart() const { return (const uint32_t*)(base + Header().outStartOffset); }
+		const dfgb_edge* OutEdges() const { return (const dfgb_edge*)(base + Header().outEdgeOffset); }
+		const uint32_t* InStart() const { return (const uint32_t*)(base + Header().inStartOffset); }
+		const dfgb_edge* InEdges() const { return (const dfgb_edge*)(base + Header().inEdgeOffset); }
+		const dfgb_access* Accesses() const { return (const dfgb_access*)(base + Header().accessOffset); }
+		const char* Strings() const { return base + Header().stringOffset; }
+
+	private:
+		const char* base;
+		uint64_t size;
+		const char* error;
+
+		bool ValidEdges(const uint32_t* start, const dfgb_edge* edges) const {	//the starts never decrease and end at nEdges, every edge ends at a node
+			const dfgb_header& header = Header();
+			for (uint32_t n = 0; n < header.nNodes; n ++)
+				if (start[n] > start[n + 1]) return false;
+			if (start[header.nNodes] != header.nEdges) return false;
+			for (uint32_t e = 0; e < header.nEdges; e ++)
+				if (edges[e].node >= header.nNodes) return false;
+			return true;
+		}
+
+		bool Fail(const char* why) {
+			if (base) munmap((void*)base, size);
+			base = 0;
+			size = 0;
+			error = why;
+			return false;
+		}
+
+		dfgb_reader(const dfgb_reader&);	//not copyable, owns the mapping
+		dfgb_reader& operator=(const dfgb_reader&);
+};
+
+#endif //_DFG_BINARY_H_
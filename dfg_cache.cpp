@@ -0,0 +1,301 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the on-disk cache of loop graph files (loop_cache).
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "dfg_cache.h"
+#include "graph_emitter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	const unsigned int cacheVersion = 15;	//bump when the files written for the same key change
+
+	class fnv_hash {	//64 bit FNV-1a, stable across runs and builds
+
+		public:
+
+			fnv_hash() : h(14695981039346656037ULL) {}
+
+			void Add(const void* data, size_t size) {
+				const unsigned char* bytes = (const unsigned char*)data;
+				for (size_t i = 0; i < size; i ++) {
+					h ^= bytes[i];
+					h *= 1099511628211ULL;
+				}
+			}
+
+			void AddInt(uint64_t v) { Add(&v, sizeof(v)); }
+
+			void AddAPInt(const APInt& v) {
+				AddInt(v.getBitWidth());
+				Add(v.getRawData(), v.getNumWords() * sizeof(uint64_t));
+			}
+
+			void AddDouble(double d) {
+				uint64_t bits;
+				memcpy(&bits, &d, sizeof(bits));
+				AddInt(bits);
+			}
+
+			uint64_t Value() const { return h; }
+
+		private:
+			uint64_t h;
+	};
+
+	void AddType(fnv_hash& h, Type* type) {	//the latency model goes by class and width
+		h.AddInt(type->getTypeID());
+		h.AddInt(type->getScalarSizeInBits());
+		if (VectorType* vec = dyn_cast<VectorType>(type)) h.AddInt(vec->getNumElements());
+	}
+
+	bool CopyFile(const string& from, const string& to) {
+		FILE* in = fopen(from.c_str(), "rb");
+		if (!in) return false;
+		FILE* out = fopen(to.c_str(), "wb");
+		if (!out) {
+			fclose(in);
+			return false;
+		}
+
+		char buf[1 << 16];
+		size_t n;
+		bool success = true;
+		while (success && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+			success = (fwrite(buf, 1, n, out) == n);
+		if (ferror(in)) success = false;
+		fclose(in);
+		if (fclose(out) != 0) success = false;
+		return success;
+	}
+
+	string OutputPrefix(unsigned int loopID) {	//file names of the graph_emitter, see graph_writer::SetFileName
+		char prefix[64];
+		snprintf(prefix, sizeof(prefix), "%u.loop_analysis_graph.", loopID);
+		return prefix;
+	}
+
+	string TempSuffix(unsigned int loopID) {	//unique among the threads and processes writing to the cache
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), ".tmp.%ld.%u", (long)getpid(), loopID);
+		return suffix;
+	}
+}
+
+loop_cache::loop_cache(const string& cacheDir) : dir(cacheDir), usable(false) {
+	if (dir.empty()) return;
+	mkdir(dir.c_str(), 0777);	//fails harmlessly if it exists
+	struct stat st;
+	usable = (stat(dir.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+uint64_t HashBytes(const void* data, size_t size) {
+	fnv_hash h;
+	h.Add(data, size);
+	return h.Value();
+}
+
+uint64_t loop_cache::Key(const loop_task& task, const string& config) {
+	fnv_hash h;
+	h.AddInt(cacheVersion);
+	h.AddInt(config.size());
+	h.Add(config.data(), config.size());
+
+	// blocks and instructions of the loop are numbered by position, values from
+	// outside by their first use; only whether two operands are the same value
+	// matters to the graph, not which value it is. Integer and floating point
+	// constants are hashed by value, -dfg-opt=fold writes them as immediates.
+	DenseMap<Value*, unsigned int> local;
+	unsigned int nLocal = 0;
+	for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+		local[task.blocks[b]] = nLocal ++;
+		for (BasicBlock::iterator ins = task.blocks[b]->begin(), ie = task.blocks[b]->end(); ins != ie; ins ++)
+			local[&*ins] = nLocal ++;
+	}
+	DenseMap<Value*, unsigned int> outside;
+
+	h.AddInt(task.blocks.size());
+	for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+		BasicBlock* bbl = task.blocks[b];
+		h.AddDouble(task.blockWt[b]);
+		h.AddInt(bbl->size());
+
+		for (BasicBlock::iterator ins = bbl->begin(), ie = bbl->end(); ins != ie; ins ++) {
+			h.AddInt(ins->getOpcode());
+			AddType(h, ins->getType());
+			if (isa<StoreInst>(&*ins) || isa<CmpInst>(&*ins)) AddType(h, ins->getOperand(0)->getType());	//their latency goes by operand 0
+			if (CastInst* cast = dyn_cast<CastInst>(&*ins)) h.AddInt(cast->isIntegerCast());
+			if (CmpInst* cmp = dyn_cast<CmpInst>(&*ins)) h.AddInt(cmp->getPredicate());	//cse only merges equal predicates
+
+			bool usedOutside = false;	//dce and GEP expansion keep a value used after the loop
+			for (Value::use_iterator use = ins->use_begin(), ue = ins->use_end(); use != ue && !usedOutside; ++use)
+				usedOutside = !isa<Instruction>(*use) || local.find(*use) == local.end();
+			h.AddInt(usedOutside);
+
+			h.AddInt(ins->getNumOperands());
+			for (unsigned int o = 0; o < ins->getNumOperands(); o ++) {
+				Value* val = ins->getOperand(o);
+				DenseMap<Value*, unsigned int>::iterator it = local.find(val);
+				if (it != local.end()) {
+					h.AddInt(1);
+					h.AddInt(it->second);
+					continue;
+				}
+				if (ConstantInt* ci = dyn_cast<ConstantInt>(val)) {
+					h.AddInt(3);
+					h.AddAPInt(ci->getValue());
+					continue;
+				}
+				if (ConstantFP* cf = dyn_cast<ConstantFP>(val)) {
+					h.AddInt(4);
+					h.AddAPInt(cf->getValueAPF().bitcastToAPInt());
+					continue;
+				}
+				unsigned int next = outside.size();
+				it = outside.insert(make_pair(val, next)).first;
+				h.AddInt(2);
+				h.AddInt(it->second);
+			}
+		}
+	}
+
+	h.AddInt(task.ctrlDeps.size());
+	for (unsigned int d = 0; d < task.ctrlDeps.size(); d ++) {
+		h.AddInt(task.ctrlDeps[d].branch);
+		h.AddInt(task.ctrlDeps[d].dependent);
+		h.AddInt(task.ctrlDeps[d].succ);
+		h.AddInt(task.ctrlDeps[d].distance);
+	}
+
+	h.AddInt(task.memOps);
+	h.AddInt(task.memDeps.size());
+	for (unsigned int d = 0; d < task.memDeps.size(); d ++) {
+		h.AddInt(task.memDeps[d].src);
+		h.AddInt(task.memDeps[d].dst);
+		h.AddInt(task.memDeps[d].kind);
+		h.AddInt(task.memDeps[d].distance);
+		h.AddInt(task.memDeps[d].unknownDistance);
+	}
+
+	h.AddInt(task.accesses.size());
+	for (unsigned int a = 0; a < task.accesses.size(); a ++) {
+		h.AddInt(task.accesses[a].pos);
+		h.AddInt(task.accesses[a].stride);
+		h.AddInt(task.accesses[a].base.size());
+		h.Add(task.accesses[a].base.data(), task.accesses[a].base.size());
+	}
+	h.AddInt(task.elided.count());	//not only the accesses decide these, a use after the loop keeps an instruction
+	for (int pos = task.elided.find_first(); pos >= 0; pos = task.elided.find_next(pos))
+		h.AddInt(pos);
+	h.AddInt(task.tripCount.size());
+	h.Add(task.tripCount.data(), task.tripCount.size());
+
+	h.AddInt(task.geps.size());	//the sizes of DataLayout, as far as the GEPs use them
+	for (unsigned int g = 0; g < task.geps.size(); g ++) {
+		h.AddInt(task.geps[g].pos);
+		h.AddInt(task.geps[g].offset);
+		h.AddInt(task.geps[g].nIndices);
+	}
+	for (unsigned int i = 0; i < task.gepIndices.size(); i ++) {
+		h.AddInt(task.gepIndices[i].operand);
+		h.AddInt(task.gepIndices[i].scale);
+	}
+	return h.Value();
+}
+
+string loop_cache::Path(uint64_t key, const string& suffix) const {
+	char name[64];
+	snprintf(name, sizeof(name), "/%016llx.", (unsigned long long)key);
+	return dir + name + suffix;
+}
+
+bool loop_cache::Fetch(uint64_t key, unsigned int loopID, double cov, cache_entry& entry) const {
+	FILE* ef = fopen(Path(key, "entry").c_str(), "r");
+	if (!ef) return false;
+
+	unsigned int version = 0;
+	bool success = (fscanf(ef, "dfg-cache %u\n", &version) == 1) && (version == cacheVersion)
+		&& (fscanf(ef, "%u %u %u %u %u %u %u %u %u %u %llu\n", &entry.nodes, &entry.edges, &entry.dataNodes,
+					&entry.gepsExpanded, &entry.backEdges, &entry.memDeps, &entry.affineAccesses, &entry.addressElided,
+					&entry.criticalPath, &entry.recMII, &entry.bytesWritten) == 11);
+	for (unsigned int k = 0; success && k < NUM_OPT_PASSES; k ++)
+		success = (fscanf(ef, "%u %u ", &entry.optNodes[k], &entry.optEdges[k]) == 2);
+	success = success && (fscanf(ef, "%u %u %u %u\n", &entry.resMII, &entry.scheduleRecMII, &entry.ii, &entry.stages) == 4);
+	success = success && (fscanf(ef, "%u %u %u %lf %lf %lf\n", &entry.mapResMII, &entry.mapRecMII, &entry.mapII,
+				&entry.fuUse, &entry.linkUse, &entry.registerUse) == 6);
+
+	entry.files.clear();
+	char line[256];
+	string prefix = OutputPrefix(loopID);
+	while (success && fgets(line, sizeof(line), ef)) {
+		string suffix(line, strcspn(line, "\n"));
+		entry.files.push_back(prefix + suffix);
+		success = RelabelGraphFile(Path(key, suffix), entry.files.back(), loopID, cov, entry.bytesWritten);
+	}
+	fclose(ef);
+	return success;
+}
+
+void loop_cache::Store(uint64_t key, unsigned int loopID, const cache_entry& entry) const {
+	string prefix = OutputPrefix(loopID);
+	string temp = TempSuffix(loopID);
+	string suffixes;
+
+	for (unsigned int f = 0; f < entry.files.size(); f ++) {
+		assert (entry.files[f].compare(0, prefix.size(), prefix) == 0);
+		string suffix = entry.files[f].substr(prefix.size());
+		string path = Path(key, suffix);
+		if (!CopyFile(entry.files[f], path + temp) || rename((path + temp).c_str(), path.c_str()) != 0) {
+			unlink((path + temp).c_str());
+			return;
+		}
+		suffixes += suffix + "\n";
+	}
+
+	string path = Path(key, "entry");	//the entry goes last, it makes the files visible to Fetch
+	FILE* ef = fopen((path + temp).c_str(), "w");
+	if (!ef) return;
+	fprintf(ef, "dfg-cache %u\n%u %u %u %u %u %u %u %u %u %u %llu\n", cacheVersion, entry.nodes, entry.edges, entry.dataNodes,
+			entry.gepsExpanded, entry.backEdges, entry.memDeps, entry.affineAccesses, entry.addressElided, entry.criticalPath,
+			entry.recMII, entry.bytesWritten);
+	for (unsigned int k = 0; k < NUM_OPT_PASSES; k ++)	//one line of node and edge counts
+		fprintf(ef, "%u %u%c", entry.optNodes[k], entry.optEdges[k], (k + 1 < NUM_OPT_PASSES) ? ' ' : '\n');
+	fprintf(ef, "%u %u %u %u\n", entry.resMII, entry.scheduleRecMII, entry.ii, entry.stages);	//the modulo schedule
+	fprintf(ef, "%u %u %u %.17g %.17g %.17g\n", entry.mapResMII, entry.mapRecMII, entry.mapII,	//the CGRA mapping
+			entry.fuUse, entry.linkUse, entry.registerUse);
+	fprintf(ef, "%s", suffixes.c_str());
+	if (fclose(ef) != 0 || rename((path + temp).c_str(), path.c_str()) != 0) unlink((path + temp).c_str());
+}
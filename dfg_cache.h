@@ -0,0 +1,96 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for dfg_cache.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DFG_CACHE_H_
+#define _DFG_CACHE_H_ 1
+
+#include "loop_graph_analysis.h"
+#include "graph_opt.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+typedef struct
+{
+	unsigned int nodes;	//counters of the loop graph, for the statistics and the report
+	unsigned int edges;
+	unsigned int dataNodes;
+	unsigned int gepsExpanded;
+	unsigned int backEdges;
+	unsigned int memDeps;
+	unsigned int affineAccesses;
+	unsigned int addressElided;
+	unsigned int criticalPath;
+	unsigned int recMII;
+	unsigned int optNodes[NUM_OPT_PASSES];	//removed by each optimization pass
+	unsigned int optEdges[NUM_OPT_PASSES];
+	unsigned int resMII;	//of the modulo schedule, 0 if the loop was not scheduled
+	unsigned int scheduleRecMII;
+	unsigned int ii;
+	unsigned int stages;
+	unsigned int mapResMII;	//of the CGRA mapping, 0 if the loop was not mapped
+	unsigned int mapRecMII;
+	unsigned int mapII;
+	double fuUse;
+	double linkUse;
+	double registerUse;
+	unsigned long long bytesWritten;
+	std::vector<std::string> files;	//output files of the loop, N.loop_analysis_graph.*
+}cache_entry;
+
+// On-disk cache of loop graph files. An entry is keyed by a hash of everything
+// the files are made of: the instructions of the loop with their operands
+// numbered by position, the block weights, control and memory dependences and
+// affine addresses of the loop_task, and the output options. No pointer goes
+// into the key, so it is the same in every run on the same IR. The loop id and
+// coverage are left out of it, they change whenever another loop is added to
+// the module; Fetch writes the ones of the loop into the files it copies, see
+// RelabelGraphFile in graph_emitter.h. Entries are written to temporary
+// names and renamed, the .entry file last, so a run that is interrupted or
+// runs next to another one never leaves a half written entry behind. Fetch and
+// Store may be called from several threads for different loops.
+class loop_cache
+{
+	public:
+		explicit loop_cache(const std::string& dir);	//creates dir if needed
+
+		bool Usable() const { return usable; }	//dir exists and is a directory
+		static uint64_t Key(const loop_task& task, const std::string& config);	//config: the options that change the files
+
+		bool Fetch(uint64_t key, unsigned int loopID, double cov, cache_entry& entry) const;	//copy the cached files into place, false on a miss
+		void Store(uint64_t key, unsigned int loopID, const cache_entry& entry) const;	//files must have been written for loopID
+
+	private:
+		std::string dir;
+		bool usable;
+
+		std::string Path(uint64_t key, const std::string& suffix) const;
+};
+
+uint64_t HashBytes(const void* data, size_t size);	//the 64 bit FNV-1a hash the cache keys are made with
+
+#endif //_DFG_CACHE_H_
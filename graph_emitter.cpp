@@ -0,0 +1,898 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the writers of the loop graph files.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "graph_emitter.h"
+#include "dfg_binary.h"
+#include "latency_model.h"
+#include "llvm/Config/config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/ADT/SmallString.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
+#include <zlib.h>
+#define DFG_ZLIB 1
+#else
+#define DFG_ZLIB 0
+#endif
+
+using namespace llvm;
+using namespace std;
+
+typedef struct
+{
+	unsigned int edge;	//index in the graph
+	unsigned int other;	//node at the other end
+	bool live;	//edge is in the final graph
+	bool inGraph;	//edge is in the graph before GEP expansion
+}emit_edge;
+
+typedef struct
+{
+	unsigned int n;	//node index
+	const char* label;	//opcode name, GEP_*, data or the name of a fused operation
+	string imm;	//folded constant operand as text, empty if none
+	bool live;	//node is in the final graph
+	bool inGraph;	//node is in the graph before GEP expansion
+	vector<emit_edge> out;
+	vector<emit_edge> in;
+	long graphOut;	//edges of the .graph file: in the graph before GEP expansion and not back-edges
+	long graphIn;
+}emit_node;
+
+class graph_writer
+{
+	public:
+		graph_writer() : bytes(0) {}
+		virtual ~graph_writer() {}
+		virtual bool Begin(const clust_graph& graph, const emit_loop& loop) = 0;	//open the file, false on failure
+		virtual void Node(const clust_graph& graph, const emit_node& node) = 0;	//called for every node in id order
+		virtual bool End() = 0;	//finish and close the file, false if writing failed
+		const string& FileName() const { return fileName; }
+		unsigned long long Bytes() const { return bytes; }	//written by the last End()
+
+	protected:
+		string fileName;
+		unsigned long long bytes;
+
+		void SetFileName(unsigned int id, const char* suffix) {
+			char name[256];
+			snprintf(name, sizeof(name), "%u.loop_analysis_graph.%s", id, suffix);
+			fileName = name;
+		}
+};
+
+namespace {
+
+	class emit_buffer {	//output file written in large blocks, optionally through zlib
+
+		public:
+
+			emit_buffer() : file(0), failed(false), written(0) {
+#if DFG_ZLIB
+				gz = 0;
+#endif
+			}
+			~emit_buffer() { Close(); }
+
+			bool Open(string& name, bool compress) {	//appends .gz to name when compressing
+				failed = false;
+				written = 0;
+				buf.clear();
+				buf.reserve(bufferSize);
+#if DFG_ZLIB
+				if (compress) {
+					name += ".gz";
+					gz = gzopen(name.c_str(), "wb");
+					return gz != 0;
+				}
+#endif
+				file = fopen(name.c_str(), "w");
+				return file != 0;
+			}
+
+			void Printf(const char* format, ...) {
+				char line[512];
+				va_list args;
+				va_start(args, format);
+				int len = vsnprintf(line, sizeof(line), format, args);
+				va_end(args);
+				assert (len >= 0 && len < (int)sizeof(line));	//writers only print short fields
+				Append(line, len);
+			}
+
+			void Append(const char* data, size_t len) {
+				written += len;
+				buf.append(data, len);
+				if (buf.size() >= bufferSize) Flush();
+			}
+
+			bool Close() {	//false if any write failed
+				Flush();
+				if (file && fclose(file) != 0) failed = true;
+				file = 0;
+#if DFG_ZLIB
+				if (gz && gzclose(gz) != Z_OK) failed = true;
+				gz = 0;
+#endif
+				return !failed;
+			}
+
+			unsigned long long Written() const { return written; }	//bytes appended since Open
+
+		private:
+
+			static const size_t bufferSize = 1 << 20;
+
+			FILE* file;
+#if DFG_ZLIB
+			gzFile gz;
+#endif
+			string buf;
+			bool failed;
+			unsigned long long written;
+
+			void Flush() {
+				if (buf.empty()) return;
+				if (file && fwrite(buf.data(), 1, buf.size(), file) != buf.size()) failed = true;
+#if DFG_ZLIB
+				if (gz && gzwrite(gz, buf.data(), buf.size()) != (int)buf.size()) failed = true;
+#endif
+				buf.clear();
+			}
+	};
+
+	char NodeKind(const clust_node& node) {	//C compute, M memory, D data
+		if (node.nodeType == DATANODE) return 'D';
+		return node.isLoad ? 'M' : 'C';
+	}
+
+	char NodeType(const clust_node& node) {	//data nodes are listed as integers
+		return (node.nodeType == DATANODE) ? 'N' : node.type;
+	}
+
+	char DepChar(clust_dep depType) {	//D data, Y/N control dependence through successor 0/1, F/A/O flow/anti/output memory dependence
+		switch (depType) {
+			case DATADEP: return 'D';
+			case CTRLDEP_0: return 'Y';
+			case CTRLDEP_1: return 'N';
+			case MEMDEP_FLOW: return 'F';
+			case MEMDEP_ANTI: return 'A';
+			default: return 'O';
+		}
+	}
+
+	const char* Distance(const clust_edge& edge, char* buf, size_t size) {	//? if unknown
+		if (edge.unknownDistance) return "?";
+		snprintf(buf, size, "%u", edge.distance);
+		return buf;
+	}
+
+	string Escaped(const string& text, bool xml) {	//for a quoted dot or JSON string, or for XML
+		string escaped;
+		for (size_t i = 0; i < text.size(); i ++) {
+			char c = text[i];
+			if (xml && c == '&') escaped += "&amp;";
+			else if (xml && c == '<') escaped += "&lt;";
+			else if (xml && c == '>') escaped += "&gt;";
+			else if (!xml && (c == '"' || c == '\\')) {
+				escaped += '\\';
+				escaped += c;
+			}
+			else escaped += c;
+		}
+		return escaped;
+	}
+
+	class text_writer : public graph_writer {	//.graph, the graph before GEP expansion
+		public:
+			explicit text_writer(bool compress) : compress(compress) {}
+
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "graph");
+				if (!out.Open(fileName, compress)) return false;
+				out.Printf("%lu\t%u\t%.5lf\n", (unsigned long)loop.graphNodes, loop.maxDepth, loop.cov);	//print no of vertices
+				recMII = loop.recMII;
+				nRecurrences = 0;
+				recurrences.clear();
+				tripCount = loop.tripCount;
+				nAccesses = 0;
+				accesses.clear();
+				schedule = loop.schedule;
+				nScheduled = 0;
+				cycles.clear();
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (schedule && cur.live && schedule->ii && schedule->cycle[cur.n] >= 0) {	//listed last, for the final graph
+					char line[64];
+					snprintf(line, sizeof(line), "%u\t%d\t%u\n", graph.Node(cur.n).id, schedule->cycle[cur.n],
+							schedule->cycle[cur.n] / schedule->ii);
+					cycles += line;
+					nScheduled ++;
+				}
+				if (!cur.inGraph) return;
+				const clust_node& node = graph.Node(cur.n);
+
+				out.Printf("%u\t%.0lf\t%c\t%c\t%ld", node.depth, node.wt, NodeKind(node), NodeType(node), cur.graphOut);
+
+				for (unsigned int k = 0; k < cur.out.size(); k ++) {	//for each edge
+					const clust_edge& edge = graph.Edge(cur.out[k].edge);
+					if (!cur.out[k].inGraph) continue;
+					const clust_node& target = graph.Node(edge.dst);
+					if (edge.backEdge) {	//listed after the nodes
+						char line[128], dist[16];
+						snprintf(line, sizeof(line), "%u\t%u\t%c\t%s\t%d\n", node.id, target.id, DepChar(edge.depType),
+								Distance(edge, dist, sizeof(dist)), node.latency);
+						recurrences += line;
+						nRecurrences ++;
+						continue;
+					}
+					out.Printf("\t%u\t%c\t%.0lf", target.id, DepChar(edge.depType), target.wt);
+				}
+
+				out.Printf("\t%ld", cur.graphIn);
+
+				for (unsigned int k = 0; k < cur.in.size(); k ++) {	//for each incoming edge
+					const clust_edge& edge = graph.Edge(cur.in[k].edge);
+					if (!cur.in[k].inGraph || edge.backEdge) continue;
+					const clust_node& source = graph.Node(edge.src);
+					out.Printf("\t%u\t%c\t%.0lf", source.id, DepChar(edge.depType), (edge.depType == DATADEP) ? source.wt : node.wt);
+				}
+
+				out.Printf("\t%u\n", node.slack);
+
+				if (node.access) {	//listed after the recurrences
+					char line[64];
+					snprintf(line, sizeof(line), "%u\t%lld\t", node.id, (long long)node.access->stride);
+					accesses += line + node.access->base + "\n";
+					nAccesses ++;
+				}
+			}
+
+			virtual bool End() {
+				out.Printf("%u\t%u\n", nRecurrences, recMII);	//recurrence edges: src, dst, dep, distance, latency of src
+				out.Append(recurrences.data(), recurrences.size());
+				if (!tripCount.empty()) {	//affine accesses: id, stride, base
+					out.Printf("%u\t", nAccesses);
+					out.Append(tripCount.data(), tripCount.size());
+					out.Append("\n", 1);
+					out.Append(accesses.data(), accesses.size());
+				}
+				else if (schedule) out.Printf("0\t?\n");	//the schedule is always the last section
+				if (schedule) {	//modulo schedule: id, cycle, stage
+					out.Printf("%u\t%u\t%u\t%u\t%u\n", nScheduled, schedule->ii, schedule->resMII, schedule->recMII, schedule->stages);
+					out.Append(cycles.data(), cycles.size());
+				}
+				bool closed = out.Close();
+				bytes = out.Written();
+				return closed;
+			}
+
+		private:
+			bool compress;
+			emit_buffer out;
+			unsigned int recMII;
+			unsigned int nRecurrences;
+			string recurrences;
+			string tripCount;
+			unsigned int nAccesses;
+			string accesses;
+			const loop_schedule* schedule;
+			unsigned int nScheduled;
+			string cycles;
+	};
+
+	class dot_writer : public graph_writer {	//.dot, the final graph
+		public:
+			explicit dot_writer(bool compress) : compress(compress) {}
+
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "dot");
+				if (!out.Open(fileName, compress)) return false;
+				out.Printf("digraph loop_analysis_graph {\n");
+				out.Printf("label=\"RecMII %u", loop.recMII);
+				if (!loop.tripCount.empty()) {
+					string label = ", trip count " + Escaped(loop.tripCount, false);
+					out.Append(label.data(), label.size());
+				}
+				schedule = loop.schedule;
+				if (schedule && schedule->ii)
+					out.Printf(", II %u (ResMII %u, RecMII %u), %u stages", schedule->ii, schedule->resMII, schedule->recMII, schedule->stages);
+				else if (schedule) out.Printf(", no schedule (ResMII %u, RecMII %u)", schedule->resMII, schedule->recMII);
+				out.Printf("\"\n");
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (!cur.live) return;
+				const clust_node& node = graph.Node(cur.n);
+				const char* I = cur.label;
+				string label;	//with the immediate and the issue cycle, if any
+				if (!cur.imm.empty()) {
+					label = string(cur.label) + " #" + cur.imm;
+					I = label.c_str();
+				}
+				if (schedule && schedule->ii && schedule->cycle[cur.n] >= 0) {
+					char when[48];
+					snprintf(when, sizeof(when), "\\n@%d (stage %u)", schedule->cycle[cur.n], schedule->cycle[cur.n] / schedule->ii);
+					label = I + string(when);
+					I = label.c_str();
+				}
+
+				if (node.gepNode) {	//nodes of an expanded GEP instruction
+					out.Printf("%u [label=\"\t%u %s\", style=filled, fillcolor=lightgrey, shape=oval]\n", node.id, node.id, I);
+
+					for (unsigned int k = 0; k < cur.in.size(); k ++)	//for each incoming edge
+						if (cur.in[k].live) PrintEdge(graph, graph.Edge(cur.in[k].edge));
+				}
+				else if (node.nodeType == INSTNODE) {
+					if (!node.isLoad) {
+						if (node.type == 'N') 	//compute node
+							out.Printf("%u [label=\"\t%u %s\", shape=oval]\n", node.id, node.id, I);
+						else if (node.type == 'F')
+							out.Printf("%u [label=\"%u %s\", shape=doublecircle]\n", node.id, node.id, I);
+						else out.Printf("%u [label=\"%u %s\", shape=triplecircle]\n", node.id, node.id, I);
+					} else if (node.access) {	//memory node with an affine address, shown as {base,+,stride}
+						const char* shape = (node.type == 'N') ? "octagon" : ((node.type == 'F') ? "doubleoctagon" : "tripleoctagon");
+						string base = Escaped(node.access->base, false);
+						out.Printf("%u [label=\"%u %s\\n{", node.id, node.id, I);
+						out.Append(base.data(), base.size());
+						out.Printf(",+,%lld}\", shape=%s]\n", (long long)node.access->stride, shape);
+					} else {
+						if (node.type == 'N') 	//memory node
+							out.Printf("%u [ label=\"%u %s\", shape=octagon]\n", node.id, node.id, I);
+						else if (node.type == 'F')
+							out.Printf("%u [label=\"%u %s\", shape=doubleoctagon]\n", node.id, node.id, I);
+						else out.Printf("%u [label=\"%u %s\", shape=tripleoctagon]\n", node.id, node.id, I);
+					}
+				}
+				else {
+					out.Printf("%u [shape=box,color=blue,label=\"%u  \"]\n", node.id, node.id);
+				}
+
+				for (unsigned int k = 0; k < cur.out.size(); k ++) {	//for each edge
+					if (!cur.out[k].live) continue;
+					const clust_edge& edge = graph.Edge(cur.out[k].edge);
+					if (graph.Node(edge.dst).gepNode) continue;	//printed as incoming edge of the GEP node
+					PrintEdge(graph, edge);
+				}
+			}
+
+			virtual bool End() {
+				out.Printf("}\n");
+				bool closed = out.Close();
+				bytes = out.Written();
+				return closed;
+			}
+
+		private:
+			bool compress;
+			emit_buffer out;
+			const loop_schedule* schedule;
+
+			static const char* MemDepName(clust_dep depType) {	//empty for other dependences
+				if (depType == MEMDEP_FLOW) return "flow";
+				if (depType == MEMDEP_ANTI) return "anti";
+				return (depType == MEMDEP_OUTPUT) ? "output" : "";
+			}
+
+			void PrintEdge(const clust_graph& graph, const clust_edge& edge) {
+				unsigned int srcID = graph.Node(edge.src).id;
+				unsigned int dstID = graph.Node(edge.dst).id;
+				char dist[16];
+				if (edge.backEdge)	//recurrence, labelled with distance and latency; it does not rank the nodes
+					out.Printf("%u -> %u [style=bold,color=darkgreen,constraint=false,label=\"%s%s%s, %d\"]\n", srcID, dstID,
+							MemDepName(edge.depType), (edge.depType >= MEMDEP_FLOW) ? " " : "", Distance(edge, dist, sizeof(dist)),
+							graph.Node(edge.src).latency);
+				else if (edge.depType >= MEMDEP_FLOW)
+					out.Printf("%u -> %u [style=dotted,color=darkorange,label=\"%s\"]\n", srcID, dstID, MemDepName(edge.depType));
+				else if (edge.depType == DATADEP)
+					out.Printf("%u -> %u [label=\"\"]\n", srcID, dstID);
+				else if (edge.depType == CTRLDEP_0)
+					out.Printf("%u -> %u [style=dashed,color=red,label=\"\"]\n", srcID, dstID);
+				else out.Printf("%u -> %u [style=dashed,color=blue,label=\"\"]\n", srcID, dstID);
+			}
+	};
+
+	class binary_writer : public graph_writer {	//.dfgb, the graph before GEP expansion
+		public:
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "dfgb");
+				FILE* lf = fopen(fileName.c_str(), "wb");	//fail early, the file is written at the end
+				if (!lf) return false;
+				fclose(lf);
+
+				this->loop = loop;
+				records.clear();
+				outStart.assign(1, 0);
+				inStart.assign(1, 0);
+				outEdges.clear();
+				inEdges.clear();
+				accesses.clear();
+				strings.clear();
+				if (!loop.tripCount.empty()) strings.append(loop.tripCount.c_str(), loop.tripCount.size() + 1);	//at offset 0
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (!cur.inGraph) return;
+				const clust_node& node = graph.Node(cur.n);
+				assert (cur.n == records.size());	//all nodes before GEP expansion are in the file, in index order
+
+				dfgb_node record;
+				memset(&record, 0, sizeof(record));
+				record.id = node.id;
+				record.depth = node.depth;
+				record.slack = node.slack;
+				record.wt = node.wt;
+				record.latency = node.latency;
+				record.ii = node.ii;
+				record.fu = node.fu;
+				record.kind = NodeKind(node);
+				record.type = NodeType(node);
+				records.push_back(record);
+
+				if (node.access) {
+					dfgb_access access;
+					memset(&access, 0, sizeof(access));
+					access.node = cur.n;
+					access.base = strings.size();
+					access.stride = node.access->stride;
+					accesses.push_back(access);
+					strings.append(node.access->base.c_str(), node.access->base.size() + 1);
+				}
+
+				for (unsigned int k = 0; k < cur.out.size(); k ++)	//back-edges are kept, flagged
+					if (cur.out[k].inGraph) AddEdge(outEdges, graph.Edge(cur.out[k].edge), cur.out[k].other);
+				for (unsigned int k = 0; k < cur.in.size(); k ++)
+					if (cur.in[k].inGraph) AddEdge(inEdges, graph.Edge(cur.in[k].edge), cur.in[k].other);
+				outStart.push_back(outEdges.size());
+				inStart.push_back(inEdges.size());
+			}
+
+			virtual bool End() {
+				FILE* lf = fopen(fileName.c_str(), "wb");
+				if (!lf) return false;
+
+				dfgb_header header;
+				dfgb_InitHeader(header, loop.id, records.size(), outEdges.size(), loop.maxDepth, loop.cov, accesses.size(), strings.size());
+				header.recMII = loop.recMII;
+				header.tripCount = 0;
+				bool written = dfgb_Write(lf, header, records.empty() ? 0 : &records[0], &outStart[0],
+						outEdges.empty() ? 0 : &outEdges[0], &inStart[0], inEdges.empty() ? 0 : &inEdges[0],
+						accesses.empty() ? 0 : &accesses[0], strings.data());
+				if (fclose(lf) != 0) written = false;
+				bytes = header.fileSize;
+				return written;
+			}
+
+		private:
+			emit_loop loop;
+			vector<dfgb_node> records;	//record i is node i
+			vector<uint32_t> outStart;
+			vector<uint32_t> inStart;
+			vector<dfgb_edge> outEdges;
+			vector<dfgb_edge> inEdges;
+			vector<dfgb_access> accesses;
+			string strings;	//the trip count first, then the base addresses
+
+			void AddEdge(vector<dfgb_edge>& edges, const clust_edge& edge, unsigned int other) {
+				dfgb_edge newEdge;
+				memset(&newEdge, 0, sizeof(newEdge));
+				newEdge.node = other;
+				newEdge.dep = DepChar(edge.depType);
+				newEdge.flags = edge.backEdge ? DFGB_BACKEDGE : 0;
+				newEdge.distance = edge.unknownDistance ? DFGB_UNKNOWN_DISTANCE : ((edge.distance < DFGB_UNKNOWN_DISTANCE) ? edge.distance : DFGB_UNKNOWN_DISTANCE - 1);
+				edges.push_back(newEdge);
+			}
+	};
+
+	class json_writer : public graph_writer {	//.json, the final graph
+		public:
+			explicit json_writer(bool compress) : compress(compress), nNodes(0) {}
+
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "json");
+				if (!out.Open(fileName, compress)) return false;
+				out.Printf("{\"loop\": %u, \"coverage\": %.5lf, \"criticalPath\": %u, \"recMII\": %u, ",
+						loop.id, loop.cov, loop.maxDepth, loop.recMII);
+				if (!loop.tripCount.empty()) {
+					string tripCount = "\"tripCount\": \"" + Escaped(loop.tripCount, false) + "\", ";
+					out.Append(tripCount.data(), tripCount.size());
+				}
+				out.Printf("\"nodes\": [");
+				nNodes = 0;
+				edges.clear();
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (!cur.live) return;
+				const clust_node& node = graph.Node(cur.n);
+
+				out.Printf("%s\n{\"id\": %u, \"label\": \"%s\", \"kind\": \"%c\", \"type\": \"%c\", \"wt\": %.0lf, \"depth\": %u, \"slack\": %u, \"latency\": %d, "
+						"\"ii\": %u, \"fu\": \"%s\"", (nNodes ++) ? "," : "", node.id, cur.label, NodeKind(node), NodeType(node), node.wt,
+						node.depth, node.slack, node.latency, node.ii, latency_model::FUName(node.fu));
+				if (node.access) {
+					string base = ", \"base\": \"" + Escaped(node.access->base, false) + "\"";
+					out.Append(base.data(), base.size());
+					out.Printf(", \"stride\": %lld", (long long)node.access->stride);
+				}
+				if (!cur.imm.empty()) out.Printf(", \"imm\": \"%s\"", cur.imm.c_str());
+				out.Printf("}");
+
+				for (unsigned int k = 0; k < cur.out.size(); k ++) {	//edges are listed after the nodes
+					if (!cur.out[k].live) continue;
+					const clust_edge& edge = graph.Edge(cur.out[k].edge);
+					char line[128], dist[16];
+					snprintf(line, sizeof(line), "%s\n{\"src\": %u, \"dst\": %u, \"dep\": \"%c\", \"back\": %s, \"distance\": %s}",
+							edges.empty() ? "" : ",", node.id, graph.Node(edge.dst).id, DepChar(edge.depType), edge.backEdge ? "true" : "false",
+							edge.unknownDistance ? "null" : Distance(edge, dist, sizeof(dist)));
+					edges += line;
+				}
+			}
+
+			virtual bool End() {
+				out.Printf("\n], \"edges\": [");
+				out.Append(edges.data(), edges.size());
+				out.Printf("\n]}\n");
+				bool closed = out.Close();
+				bytes = out.Written();
+				return closed;
+			}
+
+		private:
+			bool compress;
+			emit_buffer out;
+			unsigned int nNodes;
+			string edges;
+	};
+
+	class map_writer : public graph_writer {	//.map, the CGRA mapping of the final graph
+		public:
+			explicit map_writer(bool compress) : compress(compress) {}
+
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "map");
+				if (!out.Open(fileName, compress)) return false;
+				mapping = loop.mapping;
+				out.Printf("%u\t%u\t%u\t%u\t%u\t%.3f\t%.3f\t%.3f\n", mapping->ii, mapping->resMII, mapping->recMII,	//II 0: no mapping
+						mapping->columns, mapping->rows, mapping->fuUse, mapping->linkUse, mapping->registerUse);
+				nPlaced = 0;
+				placed.clear();
+				routes.clear();
+				for (unsigned int r = 0; mapping->ii && r < mapping->routes.size(); r ++) {	//src, dst, ready cycle, column,row of each cycle
+					const map_route& route = mapping->routes[r];
+					char line[64];
+					snprintf(line, sizeof(line), "%u\t%u\t%d", graph.Node(route.src).id, graph.Node(route.dst).id, route.cycle);
+					routes += line;
+					for (unsigned int c = 0; c < route.pes.size(); c ++) {
+						snprintf(line, sizeof(line), "%c%u,%u", c ? ' ' : '\t', route.pes[c] % mapping->columns, route.pes[c] / mapping->columns);
+						routes += line;
+					}
+					routes += "\n";
+				}
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (!cur.live || !mapping->ii || mapping->pe[cur.n] < 0) return;
+				char line[64];	//id, column, row, cycle
+				snprintf(line, sizeof(line), "%u\t%u\t%u\t%d\n", graph.Node(cur.n).id, mapping->pe[cur.n] % mapping->columns,
+						mapping->pe[cur.n] / mapping->columns, mapping->cycle[cur.n]);
+				placed += line;
+				nPlaced ++;
+			}
+
+			virtual bool End() {
+				out.Printf("%u\n", nPlaced);
+				out.Append(placed.data(), placed.size());
+				out.Printf("%lu\n", (unsigned long)(mapping->ii ? mapping->routes.size() : 0));
+				out.Append(routes.data(), routes.size());
+				bool closed = out.Close();
+				bytes = out.Written();
+				return closed;
+			}
+
+		private:
+			bool compress;
+			emit_buffer out;
+			const loop_mapping* mapping;
+			unsigned int nPlaced;
+			string placed;
+			string routes;
+	};
+
+	class graphml_writer : public graph_writer {	//.graphml, the final graph
+		public:
+			explicit graphml_writer(bool compress) : compress(compress) {}
+
+			virtual bool Begin(const clust_graph& graph, const emit_loop& loop) {
+				SetFileName(loop.id, "graphml");
+				if (!out.Open(fileName, compress)) return false;
+				out.Printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+				out.Printf("<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n");
+				out.Printf("<key id=\"label\" for=\"node\" attr.name=\"label\" attr.type=\"string\"/>\n");
+				out.Printf("<key id=\"kind\" for=\"node\" attr.name=\"kind\" attr.type=\"string\"/>\n");
+				out.Printf("<key id=\"type\" for=\"node\" attr.name=\"type\" attr.type=\"string\"/>\n");
+				out.Printf("<key id=\"wt\" for=\"node\" attr.name=\"wt\" attr.type=\"double\"/>\n");
+				out.Printf("<key id=\"depth\" for=\"node\" attr.name=\"depth\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"slack\" for=\"node\" attr.name=\"slack\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"latency\" for=\"node\" attr.name=\"latency\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"ii\" for=\"node\" attr.name=\"ii\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"fu\" for=\"node\" attr.name=\"fu\" attr.type=\"string\"/>\n");
+				out.Printf("<key id=\"dep\" for=\"edge\" attr.name=\"dep\" attr.type=\"string\"/>\n");
+				out.Printf("<key id=\"back\" for=\"edge\" attr.name=\"back\" attr.type=\"boolean\"/>\n");
+				out.Printf("<key id=\"distance\" for=\"edge\" attr.name=\"distance\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"criticalPath\" for=\"graph\" attr.name=\"criticalPath\" attr.type=\"int\"/>\n");
+				out.Printf("<key id=\"recMII\" for=\"graph\" attr.name=\"recMII\" attr.type=\"int\"/>\n");
+				if (!loop.tripCount.empty()) {	//affine addresses
+					out.Printf("<key id=\"base\" for=\"node\" attr.name=\"base\" attr.type=\"string\"/>\n");
+					out.Printf("<key id=\"stride\" for=\"node\" attr.name=\"stride\" attr.type=\"long\"/>\n");
+					out.Printf("<key id=\"tripCount\" for=\"graph\" attr.name=\"tripCount\" attr.type=\"string\"/>\n");
+				}
+				if (loop.immediates) out.Printf("<key id=\"imm\" for=\"node\" attr.name=\"imm\" attr.type=\"string\"/>\n");
+				out.Printf("<graph id=\"loop%u\" edgedefault=\"directed\">\n", loop.id);
+				out.Printf("<data key=\"criticalPath\">%u</data>\n", loop.maxDepth);
+				out.Printf("<data key=\"recMII\">%u</data>\n", loop.recMII);
+				if (!loop.tripCount.empty()) {
+					string tripCount = "<data key=\"tripCount\">" + Escaped(loop.tripCount, true) + "</data>\n";
+					out.Append(tripCount.data(), tripCount.size());
+				}
+				return true;
+			}
+
+			virtual void Node(const clust_graph& graph, const emit_node& cur) {
+				if (!cur.live) return;
+				const clust_node& node = graph.Node(cur.n);
+
+				out.Printf("<node id=\"n%u\"><data key=\"label\">%s</data><data key=\"kind\">%c</data><data key=\"type\">%c</data>"
+						"<data key=\"wt\">%.0lf</data><data key=\"depth\">%u</data><data key=\"slack\">%u</data><data key=\"latency\">%d</data>"
+						"<data key=\"ii\">%u</data><data key=\"fu\">%s</data>", node.id, cur.label, NodeKind(node), NodeType(node),
+						node.wt, node.depth, node.slack, node.latency, node.ii, latency_model::FUName(node.fu));
+				if (node.access) {
+					string base = "<data key=\"base\">" + Escaped(node.access->base, true) + "</data>";
+					out.Append(base.data(), base.size());
+					out.Printf("<data key=\"stride\">%lld</data>", (long long)node.access->stride);
+				}
+				if (!cur.imm.empty()) out.Printf("<data key=\"imm\">%s</data>", cur.imm.c_str());
+				out.Printf("</node>\n");
+
+				for (unsigned int k = 0; k < cur.out.size(); k ++) {	//edges may refer to nodes that follow
+					if (!cur.out[k].live) continue;
+					const clust_edge& edge = graph.Edge(cur.out[k].edge);
+					out.Printf("<edge source=\"n%u\" target=\"n%u\"><data key=\"dep\">%c</data><data key=\"back\">%s</data>"
+							"<data key=\"distance\">%d</data></edge>\n", node.id, graph.Node(edge.dst).id, DepChar(edge.depType),
+							edge.backEdge ? "true" : "false", edge.unknownDistance ? -1 : (int)edge.distance);	//-1 if unknown
+				}
+			}
+
+			virtual bool End() {
+				out.Printf("</graph>\n</graphml>\n");
+				bool closed = out.Close();
+				bytes = out.Written();
+				return closed;
+			}
+
+		private:
+			bool compress;
+			emit_buffer out;
+	};
+
+	const char* NodeLabel(const clust_node& node) {
+		if (node.nodeType == DATANODE) return "data";
+		if (node.label) return node.label;	//fused
+		if (!node.gepNode) return ((Instruction*)node.ins)->getOpcodeName();
+
+		switch (node.gepNodeType) {
+			case GEP_ADD1: return "GEP_ADD1";
+			case GEP_ADD2: return "GEP_ADD2";
+			case GEP_MULT: return "GEP_MULT";
+			default: return "GEP_SHL";
+		}
+	}
+
+	void Immediate(const clust_node& node, string& text) {	//the folded constant of a node, empty if none
+		text.clear();
+		if (node.gepImm) {	//offset, scale or shift of GEP expansion
+			char digits[24];
+			snprintf(digits, sizeof(digits), "%lld", (long long)node.gepImm);
+			text = digits;
+			return;
+		}
+		if (!node.imm) return;
+		SmallString<32> digits;
+		if (ConstantInt* value = dyn_cast<ConstantInt>(node.imm)) value->getValue().toString(digits, 10, value->getBitWidth() > 1);
+		else cast<ConstantFP>(node.imm)->getValueAPF().toString(digits);
+		text.assign(digits.begin(), digits.end());
+	}
+
+	void CollectEdges(const clust_graph& graph, const emit_loop& loop, unsigned int e, unsigned int other,
+			vector<emit_edge>& edges, long& graphEdges) {
+		const clust_edge& edge = graph.Edge(e);
+		emit_edge newEdge;
+		newEdge.edge = e;
+		newEdge.other = other;
+		newEdge.live = !edge.removed;
+		newEdge.inGraph = e < loop.graphEdges;
+		if (!newEdge.live && !newEdge.inGraph) return;	//added and removed again by GEP expansion or an optimization pass
+
+		edges.push_back(newEdge);
+		if (newEdge.inGraph && !edge.backEdge) graphEdges ++;
+	}
+}
+
+graph_emitter::graph_emitter(unsigned int formats, bool compress) : bytesWritten(0) {
+	compress = compress && DFG_ZLIB;
+	if (formats & (1 << EMIT_TEXT)) writers.push_back(new text_writer(compress));
+	if (formats & (1 << EMIT_DOT)) writers.push_back(new dot_writer(compress));
+	if (formats & (1 << EMIT_BINARY)) writers.push_back(new binary_writer());
+	if (formats & (1 << EMIT_JSON)) writers.push_back(new json_writer(compress));
+	if (formats & (1 << EMIT_GRAPHML)) writers.push_back(new graphml_writer(compress));
+	if (formats & (1 << EMIT_MAP)) writers.push_back(new map_writer(compress));
+}
+
+graph_emitter::~graph_emitter() {
+	for (unsigned int w = 0; w < writers.size(); w ++) delete writers[w];
+}
+
+bool graph_emitter::Emit(const clust_graph& graph, const emit_loop& loop, string& errors) {
+	vector<graph_writer*> open;	//writers whose file could be opened
+	for (unsigned int w = 0; w < writers.size(); w ++) {
+		if (writers[w]->Begin(graph, loop)) open.push_back(writers[w]);
+		else errors += "cannot write " + writers[w]->FileName() + "\n";
+	}
+
+	// node indices are in id order, ids are handed out as nodes are added
+	emit_node cur;
+	for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+		const clust_node& node = graph.Node(n);
+		cur.n = n;
+		cur.live = !node.removed;
+		cur.inGraph = n < loop.graphNodes;
+		if (!cur.live && !cur.inGraph) continue;
+		cur.label = NodeLabel(node);
+		Immediate(node, cur.imm);
+
+		cur.out.clear();
+		cur.graphOut = 0;
+		for (unsigned int k = graph.OutBegin(n); k != graph.OutEnd(n); k ++)
+			CollectEdges(graph, loop, graph.OutEdge(k), graph.Edge(graph.OutEdge(k)).dst, cur.out, cur.graphOut);
+
+		cur.in.clear();
+		cur.graphIn = 0;
+		for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++)
+			CollectEdges(graph, loop, graph.InEdge(k), graph.Edge(graph.InEdge(k)).src, cur.in, cur.graphIn);
+
+		for (unsigned int w = 0; w < open.size(); w ++) open[w]->Node(graph, cur);
+	}
+
+	bool success = (open.size() == writers.size());
+	bytesWritten = 0;
+	filesWritten.clear();
+	for (unsigned int w = 0; w < open.size(); w ++) {
+		bool closed = open[w]->End();
+		bytesWritten += open[w]->Bytes();
+		if (closed) {
+			filesWritten.push_back(open[w]->FileName());
+			continue;
+		}
+		errors += "cannot write " + open[w]->FileName() + "\n";
+		success = false;
+	}
+	return success;
+}
+
+bool CompressionAvailable() {
+	return DFG_ZLIB;
+}
+
+namespace {
+
+	bool HasSuffix(const string& name, const string& suffix) {
+		return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	bool ReadFile(const string& name, bool compressed, string& data) {
+		char buf[1 << 16];
+		data.clear();
+#if DFG_ZLIB
+		if (compressed) {
+			gzFile gz = gzopen(name.c_str(), "rb");
+			if (!gz) return false;
+			int n;
+			while ((n = gzread(gz, buf, sizeof(buf))) > 0) data.append(buf, n);
+			return (gzclose(gz) == Z_OK) && n == 0;
+		}
+#endif
+		if (compressed) return false;
+		FILE* in = fopen(name.c_str(), "rb");
+		if (!in) return false;
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), in)) > 0) data.append(buf, n);
+		bool success = !ferror(in);
+		fclose(in);
+		return success;
+	}
+
+	bool Replace(string& data, size_t begin, size_t end, const string& text) {	//false if the field was not found
+		if (begin == string::npos || end == string::npos || end < begin) return false;
+		data.replace(begin, end - begin, text);
+		return true;
+	}
+}
+
+bool RelabelGraphFile(const string& from, const string& to, unsigned int id, double cov, unsigned long long& bytes) {
+	bool compressed = HasSuffix(to, ".gz");
+	string name = compressed ? to.substr(0, to.size() - 3) : to;
+	string data;
+	if (!ReadFile(from, compressed, data)) return false;
+	size_t oldSize = data.size();
+
+	char field[64];
+	bool found = true;
+	if (HasSuffix(name, ".graph")) {	//nodes, critical path and coverage on the first line
+		size_t tab = data.find('\t');
+		tab = (tab == string::npos) ? tab : data.find('\t', tab + 1);
+		snprintf(field, sizeof(field), "\t%.5lf", cov);
+		found = Replace(data, tab, data.find('\n'), field);
+	}
+	else if (HasSuffix(name, ".json")) {
+		snprintf(field, sizeof(field), "{\"loop\": %u, \"coverage\": %.5lf", id, cov);
+		found = (data.compare(0, 9, "{\"loop\": ") == 0) && Replace(data, 0, data.find(", \"criticalPath\""), field);
+	}
+	else if (HasSuffix(name, ".graphml")) {
+		size_t graph = data.find("<graph id=\"loop");
+		size_t begin = (graph == string::npos) ? graph : graph + strlen("<graph id=\"loop");
+		snprintf(field, sizeof(field), "%u", id);
+		found = Replace(data, begin, data.find('"', begin), field);
+	}
+	else if (HasSuffix(name, ".dfgb")) {
+		dfgb_header header;
+		found = data.size() >= sizeof(header) && memcmp(data.data(), "DFGB", 4) == 0;
+		if (found) {
+			memcpy(&header, data.data(), sizeof(header));
+			header.loopID = id;
+			header.cov = cov;
+			data.replace(0, sizeof(header), (const char*)&header, sizeof(header));
+		}
+	}
+	if (!found) return false;	//not written by this version
+
+	emit_buffer out;
+	if (!out.Open(name, compressed)) return false;
+	out.Append(data.data(), data.size());
+	if (!out.Close()) return false;
+	bytes = bytes + data.size() - oldSize;	//the loop id may have a different number of digits
+	return true;
+}
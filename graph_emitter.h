@@ -0,0 +1,101 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for graph_emitter.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _GRAPH_EMITTER_H_
+#define _GRAPH_EMITTER_H_ 1
+
+#include "loop_graph_analysis.h"
+#include "modulo_schedule.h"
+#include "cgra_map.h"
+#include <string>
+
+typedef enum
+{
+	EMIT_TEXT,	//N.loop_analysis_graph.graph
+	EMIT_DOT,	//N.loop_analysis_graph.dot
+	EMIT_BINARY,	//N.loop_analysis_graph.dfgb, see dfg_binary.h
+	EMIT_JSON,	//N.loop_analysis_graph.json
+	EMIT_GRAPHML,	//N.loop_analysis_graph.graphml
+	EMIT_MAP	//N.loop_analysis_graph.map, placement and routing on the CGRA
+}emit_format;	//bit positions in the format mask of graph_emitter
+
+typedef struct
+{
+	unsigned int id;	//loop id
+	double cov;	//coverage of the loop
+	unsigned int maxDepth;
+	unsigned int recMII;	//see clust_graph::RecMII
+	std::string tripCount;	//iterations per run, see loop_task; empty if no node has an affine address
+	unsigned int immediates;	//nodes of the final graph with a folded constant, see graph_opt.h
+	unsigned int graphNodes;	//nodes and edges in the graph before GEP expansion,
+	unsigned int graphEdges;	//the .graph and .dfgb files show that graph
+	const loop_schedule* schedule;	//modulo schedule of the final graph, 0 if it was not scheduled
+	const loop_mapping* mapping;	//CGRA mapping of the final graph, 0 if it was not mapped
+}emit_loop;
+
+class graph_writer;
+
+// Writes the files of a loop graph. The graph is walked once, in id order, and
+// every node with its edges is handed to the writers of all requested formats.
+// The .graph and .dfgb files show the graph as it was before GEP expansion
+// and the passes of graph_opt.h: the nodes and edges below emit_loop.graphNodes/
+// graphEdges, whether removed since or not. The other formats show the final
+// graph, with fused operations and immediates. Text output is buffered, and
+// written through zlib (with a .gz suffix) when compression is requested and
+// LLVM was built with zlib; binary files are never compressed so that they can
+// be mapped.
+class graph_emitter
+{
+	public:
+		graph_emitter(unsigned int formats, bool compress);	//formats: mask of 1 << emit_format
+		~graph_emitter();
+
+		bool Emit(const clust_graph& graph, const emit_loop& loop, std::string& errors);	//false if a file could not be written
+		unsigned long long BytesWritten() const { return bytesWritten; }	//by the last Emit, before compression
+		const std::vector<std::string>& FilesWritten() const { return filesWritten; }	//by the last Emit
+
+	private:
+		std::vector<graph_writer*> writers;
+		unsigned long long bytesWritten;
+		std::vector<std::string> filesWritten;
+
+		graph_emitter(const graph_emitter&);	//owns the writers
+		graph_emitter& operator=(const graph_emitter&);
+};
+
+bool CompressionAvailable();	//LLVM was built with zlib
+
+// Copies a file written by the graph_emitter for some loop to the name "to",
+// with the loop id and coverage in it replaced by id and cov, so that the files
+// of a loop can be reused for the same loop under another id or coverage. A
+// .gz file is decompressed and compressed again. bytes is adjusted by the
+// change in size before compression. False if a file could not be read or
+// written, or if the fields were not where the writers put them.
+bool RelabelGraphFile(const std::string& from, const std::string& to, unsigned int id, double cov, unsigned long long& bytes);
+
+#endif //_GRAPH_EMITTER_H_
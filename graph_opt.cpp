@@ -0,0 +1,383 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the optimization passes of the final loop graph (graph_pipeline).
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "graph_opt.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	const char* passNames[NUM_OPT_PASSES] = {
+		"dce",
+		"cse",
+		"fold",
+		"fuse"
+	};
+
+	void AddCopy(clust_graph& graph, const clust_edge& edge, graph_ids& ids) {	//a new edge like edge, between edge.src and edge.dst
+		unsigned int e = graph.AddEdge(edge.src, edge.dst, edge.depType, edge.wt, ++ ids.edge);
+		graph.Edge(e).distance = edge.distance;
+		graph.Edge(e).unknownDistance = edge.unknownDistance;
+		graph.Edge(e).backEdge = edge.backEdge;
+	}
+
+	// Removes every node n with into[n] != n and moves its out-edges to into[n], and
+	// its in-edges as well if keepInputs. Edges between nodes that go into the same
+	// node disappear, control and memory edges that would be doubled are added once.
+	void Replace(clust_graph& graph, const vector<unsigned int>& into, bool keepInputs, graph_ids& ids) {
+		vector<clust_edge> copies;
+		set<pair<pair<unsigned int, unsigned int>, int> > ordering;	//control and memory edges copied so far
+		for (unsigned int e = 0; e < graph.NumEdges(); e ++) {
+			clust_edge edge = graph.Edge(e);
+			if (edge.removed) continue;
+			unsigned int src = into[edge.src];
+			unsigned int dst = into[edge.dst];
+			if (src == edge.src && dst == edge.dst) continue;	//both ends stay
+			if (src == dst) continue;	//inside a fused node
+			if (dst != edge.dst && !keepInputs) continue;	//a merged node takes the inputs of the one it goes into
+			if (edge.depType != DATADEP && !ordering.insert(make_pair(make_pair(src, dst), (int)edge.depType)).second) continue;
+			edge.src = src;
+			edge.dst = dst;
+			copies.push_back(edge);
+		}
+
+		for (unsigned int n = 0; n < into.size(); n ++)	//detach first, removing needs the rows of the graph
+			if (into[n] != n) graph.RemoveNode(n);
+		for (unsigned int c = 0; c < copies.size(); c ++)
+			AddCopy(graph, copies[c], ids);
+		graph.Finalize();
+	}
+
+	// Live nodes with their producers first, over the live edges that are not back-edges.
+	void TopoOrder(const clust_graph& graph, vector<unsigned int>& order) {
+		vector<unsigned int> pending(graph.NumNodes(), 0);	//producers not in the order yet
+		order.clear();
+		for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+			if (graph.Node(n).removed) continue;
+			for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++) {
+				const clust_edge& edge = graph.Edge(graph.InEdge(k));
+				if (!edge.removed && !edge.backEdge) pending[n] ++;
+			}
+			if (!pending[n]) order.push_back(n);
+		}
+
+		for (unsigned int i = 0; i < order.size(); i ++) {
+			unsigned int n = order[i];
+			for (unsigned int k = graph.OutBegin(n); k != graph.OutEnd(n); k ++) {
+				const clust_edge& edge = graph.Edge(graph.OutEdge(k));
+				if (!edge.removed && !edge.backEdge && -- pending[edge.dst] == 0) order.push_back(edge.dst);
+			}
+		}
+	}
+
+	class dce_pass : public graph_pass {	//marks what the roots need, over data edges, and removes the rest
+		public:
+			virtual void Run(clust_graph& graph, graph_ids& ids) const {
+				vector<bool> live(graph.NumNodes(), false);
+				vector<unsigned int> work;
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+					if (graph.Node(n).removed || !Root(graph, n)) continue;
+					live[n] = true;
+					work.push_back(n);
+				}
+
+				while (!work.empty()) {
+					unsigned int n = work.back();
+					work.pop_back();
+					for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++) {
+						const clust_edge& edge = graph.Edge(graph.InEdge(k));
+						if (edge.removed || edge.depType != DATADEP || live[edge.src]) continue;
+						live[edge.src] = true;
+						work.push_back(edge.src);
+					}
+				}
+
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++)
+					if (!live[n]) graph.RemoveNode(n);
+			}
+
+		private:
+			static bool Root(const clust_graph& graph, unsigned int n) {	//has an effect or a result used outside of the graph
+				const clust_node& node = graph.Node(n);
+				Instruction* ins = dyn_cast<Instruction>(node.ins);
+				if (node.nodeType == DATANODE || !ins) return false;
+				if (node.gepNode && node.gepNodeType != GEP_ADD1) return false;	//add1 produces the address of the GEP
+				if (isa<TerminatorInst>(ins) || ins->mayHaveSideEffects()) return true;
+
+				for (Value::use_iterator use = ins->use_begin(), ue = ins->use_end(); use != ue; ++use) {
+					Instruction* user = dyn_cast<Instruction>(*use);
+					if (!user || graph.Find(user) < 0) return true;	//after the loop, or an elided address computation
+				}
+				return false;
+			}
+	};
+
+	class cse_pass : public graph_pass {	//in topological order, so that the operands are merged before their users
+		public:
+			virtual void Run(clust_graph& graph, graph_ids& ids) const {
+				vector<unsigned int> order;
+				TopoOrder(graph, order);
+
+				vector<unsigned int> into(graph.NumNodes());
+				for (unsigned int n = 0; n < into.size(); n ++) into[n] = n;
+
+				map<vector<uintptr_t>, unsigned int> first;	//key -> first node with it
+				vector<uintptr_t> key;
+				bool merged = false;
+				for (unsigned int i = 0; i < order.size(); i ++) {
+					unsigned int n = order[i];
+					if (!Key(graph, n, into, key)) continue;
+					pair<map<vector<uintptr_t>, unsigned int>::iterator, bool> found = first.insert(make_pair(key, n));
+					if (found.second || !SameOperation(graph.Node(found.first->second), graph.Node(n))) continue;
+					into[n] = found.first->second;
+					merged = true;
+				}
+
+				if (merged) Replace(graph, into, false, ids);
+			}
+
+		private:
+			// Operation, operands (as their nodes after merging) and block of a node; false
+			// if the node cannot be merged. Nodes without inputs are the same in every block.
+			static bool Key(const clust_graph& graph, unsigned int n, const vector<unsigned int>& into, vector<uintptr_t>& key) {
+				const clust_node& node = graph.Node(n);
+				if (node.removed || node.nodeType != INSTNODE || node.label) return false;
+				key.clear();
+
+				vector<pair<uintptr_t, uintptr_t> > inputs;	//(node, dependence) or (0, constant)
+				if (node.gepNode) {	//the expansion nodes are additions and multiplications, their inputs are in any order
+					key.push_back(node.gepNodeType);
+					key.push_back((uintptr_t)node.gepImm);
+					for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++) {
+						const clust_edge& edge = graph.Edge(graph.InEdge(k));
+						if (!edge.removed) inputs.push_back(make_pair((uintptr_t)into[edge.src] + 1, (uintptr_t)edge.depType));
+					}
+					if (node.imm) inputs.push_back(make_pair((uintptr_t)0, (uintptr_t)node.imm));
+					std::sort(inputs.begin(), inputs.end());
+				}
+				else {
+					Instruction* ins = dyn_cast<Instruction>(node.ins);
+					if (!ins || !(isa<BinaryOperator>(ins) || isa<CmpInst>(ins) || isa<CastInst>(ins) || isa<SelectInst>(ins))) return false;
+					key.push_back(GEP_SHL + 1 + ins->getOpcode());
+					key.push_back((uintptr_t)ins->getType());
+					if (CmpInst* cmp = dyn_cast<CmpInst>(ins)) key.push_back(cmp->getPredicate());
+
+					for (unsigned int op = 0; op < ins->getNumOperands(); op ++) {	//in operand order
+						uintptr_t producer = Producer(graph, n, ins->getOperand(op), into);
+						if (!producer && node.imm != ins->getOperand(op)) return false;
+						inputs.push_back(producer ? make_pair(producer, (uintptr_t)DATADEP) : make_pair((uintptr_t)0, (uintptr_t)node.imm));
+					}
+					if (ins->isCommutative()) std::sort(inputs.begin(), inputs.end());
+
+					unsigned int nOperands = inputs.size();	//then the control dependences, in any order
+					for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++) {
+						const clust_edge& edge = graph.Edge(graph.InEdge(k));
+						if (!edge.removed && edge.depType != DATADEP) inputs.push_back(make_pair((uintptr_t)into[edge.src] + 1, (uintptr_t)edge.depType));
+					}
+					std::sort(inputs.begin() + nOperands, inputs.end());
+				}
+
+				for (unsigned int i = 0; i < inputs.size(); i ++) {
+					key.push_back(inputs[i].first);
+					key.push_back(inputs[i].second);
+				}
+				if (graph.InDegree(n)) {	//the same operation in another block may run under other conditions
+					Instruction* ins = dyn_cast<Instruction>(node.ins);
+					key.push_back(ins ? (uintptr_t)ins->getParent() : 0);
+				}
+				return true;
+			}
+
+			// Node producing operand op of n, after merging, plus one; 0 if it has no data edge into n.
+			static uintptr_t Producer(const clust_graph& graph, unsigned int n, Value* op, const vector<unsigned int>& into) {
+				for (unsigned int k = graph.InBegin(n); k != graph.InEnd(n); k ++) {
+					const clust_edge& edge = graph.Edge(graph.InEdge(k));
+					if (edge.removed || edge.depType != DATADEP) continue;
+					const clust_node& src = graph.Node(edge.src);
+					if (src.ins == op && (!src.gepNode || src.gepNodeType == GEP_ADD1)) return (uintptr_t)into[edge.src] + 1;
+				}
+				return 0;
+			}
+
+			static bool SameOperation(const clust_node& a, const clust_node& b) {	//what the key leaves out, e.g. the indices of a cast
+				if (a.gepNode) return true;
+				return cast<Instruction>(a.ins)->isSameOperationAs(cast<Instruction>(b.ins));
+			}
+	};
+
+	class fold_pass : public graph_pass {	//constants become immediates of their consumers
+		public:
+			virtual void Run(clust_graph& graph, graph_ids& ids) const {
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+					const clust_node& node = graph.Node(n);
+					if (node.removed || node.nodeType != DATANODE || !(isa<ConstantInt>(node.ins) || isa<ConstantFP>(node.ins))) continue;
+
+					unsigned int left = 0;	//edges that keep the data node
+					for (unsigned int k = graph.OutBegin(n); k != graph.OutEnd(n); k ++) {
+						unsigned int e = graph.OutEdge(k);
+						const clust_edge& edge = graph.Edge(e);
+						if (edge.removed) continue;
+						clust_node& user = graph.Node(edge.dst);
+						if (edge.depType != DATADEP || user.nodeType != INSTNODE || user.imm || user.gepImm) {	//one immediate per node
+							left ++;
+							continue;
+						}
+						user.imm = node.ins;
+						graph.RemoveEdge(e);
+					}
+					if (!left) graph.RemoveNode(n);
+				}
+			}
+	};
+
+	typedef struct
+	{
+		unsigned int producer;	//opcodes
+		unsigned int consumer;
+		const char* name;	//of the fused operation
+	}fuse_pattern;
+
+	const fuse_pattern fusePatterns[] = {
+		{ Instruction::Mul, Instruction::Add, "muladd" },
+		{ Instruction::FMul, Instruction::FAdd, "fmuladd" },
+		{ Instruction::ICmp, Instruction::Select, "icmpselect" },
+		{ Instruction::FCmp, Instruction::Select, "fcmpselect" }
+	};
+
+	class fuse_pass : public graph_pass {	//a producer goes into the new fused node together with its only consumer
+		public:
+			virtual void Run(clust_graph& graph, graph_ids& ids) const {
+				unsigned int nNodes = graph.NumNodes();
+				vector<unsigned int> into(nNodes);
+				for (unsigned int n = 0; n < nNodes; n ++) into[n] = n;
+
+				bool fused = false;
+				for (unsigned int p = 0; p < nNodes; p ++) {
+					if (into[p] != p) continue;	//already fused as a consumer
+					int c = OnlyConsumer(graph, p);
+					if (c < 0 || into[c] != (unsigned int)c) continue;
+					const char* name = FusedName(graph.Node(p), graph.Node(c));
+					if (!name) continue;
+
+					unsigned int f = graph.AddNode(graph.Node(c).ins, false);	//the value of the consumer, not keyed
+					clust_node& node = graph.Node(f);
+					const clust_node& prod = graph.Node(p);
+					node = graph.Node(c);
+					node.id = 0;
+					node.label = name;
+					node.depth = prod.depth;	//starts with the producer
+					node.slack = min(prod.slack, node.slack);
+					node.latency = max(prod.latency, 0) + max(node.latency, 0);
+					node.ii = max(prod.ii, node.ii);
+					node.fu = prod.fu;
+					if (!node.imm) node.imm = prod.imm;
+					graph.SetNodeID(f, ++ ids.node);
+
+					into.push_back(f);
+					into[p] = f;
+					into[c] = f;
+					fused = true;
+				}
+
+				if (fused) Replace(graph, into, true, ids);
+			}
+
+		private:
+			static int OnlyConsumer(const clust_graph& graph, unsigned int n) {	//of the one live out-edge of n, a data edge in the iteration; -1 if none
+				int consumer = -1;
+				for (unsigned int k = graph.OutBegin(n); k != graph.OutEnd(n); k ++) {
+					const clust_edge& edge = graph.Edge(graph.OutEdge(k));
+					if (edge.removed) continue;
+					if (consumer >= 0 || edge.depType != DATADEP || edge.backEdge || edge.dst == n) return -1;
+					consumer = edge.dst;
+				}
+				return consumer;
+			}
+
+			static bool Fusable(const clust_node& node) {
+				return !node.removed && node.nodeType == INSTNODE && !node.gepNode && !node.label && isa<Instruction>(node.ins);
+			}
+
+			static const char* FusedName(const clust_node& prod, const clust_node& cons) {	//0 if the pair matches no pattern
+				if (!Fusable(prod) || !Fusable(cons) || (prod.imm && cons.imm)) return 0;
+				Instruction* producer = cast<Instruction>(prod.ins);
+				Instruction* consumer = cast<Instruction>(cons.ins);
+				if (producer->getParent() != consumer->getParent()) return 0;	//under the same conditions
+
+				if (SelectInst* select = dyn_cast<SelectInst>(consumer))	//the compare must be the condition
+					if (select->getType() == producer->getType() && select->getCondition() != producer) return 0;
+
+				for (unsigned int i = 0; i < sizeof(fusePatterns) / sizeof(fusePatterns[0]); i ++)
+					if (producer->getOpcode() == fusePatterns[i].producer && consumer->getOpcode() == fusePatterns[i].consumer)
+						return fusePatterns[i].name;
+				return 0;
+			}
+	};
+}
+
+graph_pipeline::~graph_pipeline() {
+	for (unsigned int p = 0; p < passes.size(); p ++) delete passes[p];
+}
+
+void graph_pipeline::Add(opt_pass_kind kind) {
+	graph_pass* pass = 0;
+	switch (kind) {
+		case OPT_DCE: pass = new dce_pass(); break;
+		case OPT_CSE: pass = new cse_pass(); break;
+		case OPT_FOLD: pass = new fold_pass(); break;
+		case OPT_FUSE: pass = new fuse_pass(); break;
+		default: break;
+	}
+	assert (pass);
+	kinds.push_back(kind);
+	passes.push_back(pass);
+}
+
+opt_result graph_pipeline::Run(unsigned int p, clust_graph& graph, graph_ids& ids) const {
+	unsigned int nodes = graph.NumLiveNodes();
+	unsigned int edges = graph.NumLiveEdges();
+	passes[p]->Run(graph, ids);
+	assert (graph.NumLiveNodes() <= nodes && graph.NumLiveEdges() <= edges);	//no pass grows the graph
+
+	opt_result result;
+	result.nodes = nodes - graph.NumLiveNodes();
+	result.edges = edges - graph.NumLiveEdges();
+	return result;
+}
+
+const char* graph_pipeline::PassName(opt_pass_kind kind) {
+	return passNames[kind];
+}
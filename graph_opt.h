@@ -0,0 +1,100 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for graph_opt.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GRAPH_OPT_H_
+#define _GRAPH_OPT_H_ 1
+
+#include "loop_graph_analysis.h"
+#include <vector>
+
+typedef enum
+{
+	OPT_DCE,	//dead-node elimination
+	OPT_CSE,	//identical nodes merged
+	OPT_FOLD,	//constant operands folded into immediates
+	OPT_FUSE,	//producer and consumer fused into one operation, e.g. multiply-add
+	NUM_OPT_PASSES
+}opt_pass_kind;
+
+typedef struct
+{
+	unsigned int node;	//last node and edge id handed out in the loop,
+	unsigned int edge;	//the ids of new nodes and edges follow them
+}graph_ids;
+
+typedef struct
+{
+	unsigned int nodes;	//live nodes and edges a pass removed, net of the ones it added
+	unsigned int edges;
+}opt_result;
+
+// A transformation of the final loop graph, run after GEP expansion. A pass
+// marks nodes and edges removed and appends the new ones, as GEP expansion
+// does, so the .graph and .dfgb files still show the graph before both. It has
+// no state of its own: one instance serves the loops of all threads.
+class graph_pass
+{
+	public:
+		virtual ~graph_pass() {}
+		virtual void Run(clust_graph& graph, graph_ids& ids) const = 0;	//the graph is finalized before and after
+};
+
+// The optimization passes of -dfg-opt, run in the order given:
+//
+//	dce	removes the nodes whose results are not used: pure operations without a
+//		live data consumer in the loop or a user outside of it
+//	cse	merges nodes that compute the same operation of the same operands in the
+//		same block into the first of them
+//	fold	turns the edge from an integer or floating point constant into an
+//		immediate of its consumer, one per node; data nodes left unused go
+//	fuse	fuses a producer into its only consumer in the same block, with the
+//		patterns mul+add, fmul+fadd, icmp+select and fcmp+select; the fused node
+//		takes the unit of the producer and the sum of both latencies
+//
+// A new pass derives from graph_pass and gets an opt_pass_kind and a name.
+class graph_pipeline
+{
+	public:
+		graph_pipeline() {}
+		~graph_pipeline();
+
+		void Add(opt_pass_kind kind);
+		unsigned int NumPasses() const { return kinds.size(); }
+		opt_pass_kind Kind(unsigned int p) const { return kinds[p]; }
+		opt_result Run(unsigned int p, clust_graph& graph, graph_ids& ids) const;	//run pass p on the graph
+
+		static const char* PassName(opt_pass_kind kind);
+
+	private:
+		std::vector<opt_pass_kind> kinds;
+		std::vector<graph_pass*> passes;
+
+		graph_pipeline(const graph_pipeline&);	//owns the passes
+		graph_pipeline& operator=(const graph_pipeline&);
+};
+
+#endif //_GRAPH_OPT_H_
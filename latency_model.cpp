@@ -0,0 +1,179 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the latency and functional unit model (latency_model).
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "latency_model.h"
+#include "llvm/IR/Instruction.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	enum {	//opcodes of the GEP expansion nodes, behind those of LLVM
+		OP_GEP_ADD = Instruction::OtherOpsEnd,
+		OP_GEP_MULT,
+		OP_GEP_SHL,
+		OP_END
+	};
+
+	const char* fuNames[NUM_FU_CLASSES] = {
+		"NONE",
+		"ALU",
+		"MUL",
+		"MEM",
+		"FP"
+	};
+
+	fu_class DefaultFU(unsigned int opcode) {
+		switch (opcode) {
+			case Instruction::PHI:
+				return FU_NONE;
+			case Instruction::Load:
+			case Instruction::Store:
+			case Instruction::Alloca:
+			case Instruction::Fence:
+			case Instruction::AtomicCmpXchg:
+			case Instruction::AtomicRMW:
+				return FU_MEM;
+			case Instruction::Mul:
+			case Instruction::UDiv:
+			case Instruction::SDiv:
+			case Instruction::URem:
+			case Instruction::SRem:
+			case OP_GEP_MULT:
+				return FU_MUL;
+			case Instruction::FAdd:
+			case Instruction::FSub:
+			case Instruction::FMul:
+			case Instruction::FDiv:
+			case Instruction::FRem:
+			case Instruction::FPTrunc:
+			case Instruction::FPExt:
+			case Instruction::FPToUI:
+			case Instruction::FPToSI:
+			case Instruction::UIToFP:
+			case Instruction::SIToFP:
+			case Instruction::FCmp:
+				return FU_FP;
+			default:
+				return FU_ALU;
+		}
+	}
+
+	int ParseOpcode(const char* name) {	//-1 if unknown
+		if (strcmp(name, "GEP_ADD") == 0) return OP_GEP_ADD;
+		if (strcmp(name, "GEP_MULT") == 0) return OP_GEP_MULT;
+		if (strcmp(name, "GEP_SHL") == 0) return OP_GEP_SHL;
+		for (unsigned int op = 1; op < Instruction::OtherOpsEnd; op ++)
+			if (strcmp(name, Instruction::getOpcodeName(op)) == 0) return op;
+		return -1;
+	}
+
+	int ParseFU(const char* name) {
+		for (unsigned int fu = 0; fu < NUM_FU_CLASSES; fu ++)
+			if (strcmp(name, fuNames[fu]) == 0) return fu;
+		return -1;
+	}
+}
+
+latency_model::latency_model() : nOpcodes(OP_END) {
+	table.resize(nOpcodes * NUM_TYPES * NUM_WIDTHS);
+	for (unsigned int op = 0; op < nOpcodes; op ++) {
+		latency_entry entry;
+		entry.fu = DefaultFU(op);
+		entry.latency = (op == Instruction::PHI) ? 0 : 1;	//a PHI only selects a value
+		entry.ii = (op == Instruction::PHI) ? 0 : 1;
+		Set(op, -1, -1, entry);
+	}
+}
+
+void latency_model::Set(unsigned int opcode, int type, int width, const latency_entry& entry) {
+	for (unsigned int t = 0; t < NUM_TYPES; t ++) {
+		if (type >= 0 && (unsigned int)type != t) continue;
+		for (unsigned int w = 0; w < NUM_WIDTHS; w ++) {
+			if (width >= 0 && (unsigned int)width != w) continue;
+			table[(opcode * NUM_TYPES + t) * NUM_WIDTHS + w] = entry;
+		}
+	}
+}
+
+bool latency_model::Load(const string& fileName, string& error) {
+	FILE* cf = fopen(fileName.c_str(), "r");
+	if (!cf) {
+		error = "cannot open " + fileName;
+		return false;
+	}
+
+	char line[512];
+	unsigned int lineNo = 0;
+	while (fgets(line, sizeof(line), cf)) {
+		lineNo ++;
+		char* comment = strchr(line, '#');
+		if (comment) *comment = 0;
+
+		char opName[64], typeName[8], widthName[8], fuName[8];
+		int latency, ii;
+		int n = sscanf(line, "%63s %7s %7s %d %d %7s", opName, typeName, widthName, &latency, &ii, fuName);
+		if (n <= 0) continue;	//empty or comment only
+
+		int opcode = (n == 6) ? ParseOpcode(opName) : -1;
+		int type = -1;
+		if (n == 6 && strcmp(typeName, "*") != 0) type = (strlen(typeName) == 1 && strchr("NFV", typeName[0])) ? (int)TypeIndex(typeName[0]) : -2;
+		int width = -1;
+		if (n == 6 && strcmp(widthName, "*") != 0) width = (atoi(widthName) > 0) ? (int)WidthIndex(atoi(widthName)) : -2;
+		int fu = (n == 6) ? ParseFU(fuName) : -1;
+
+		if (opcode < 0 || type < -1 || width < -1 || fu < 0 || latency < 0 || latency > 32767 || ii < 0 || ii > 255) {
+			char where[32];
+			snprintf(where, sizeof(where), ":%u: ", lineNo);
+			error = fileName + where + "expected: opcode type width latency ii fu";
+			fclose(cf);
+			return false;
+		}
+
+		latency_entry entry;
+		entry.latency = latency;
+		entry.ii = ii;
+		entry.fu = fu;
+		Set(opcode, type, width, entry);
+	}
+	fclose(cf);
+	return true;
+}
+
+const latency_entry& latency_model::LookupGEP(gep_nodeType gepNodeType) const {
+	unsigned int opcode = (gepNodeType == GEP_MULT) ? OP_GEP_MULT : (gepNodeType == GEP_SHL) ? OP_GEP_SHL : OP_GEP_ADD;
+	return Lookup(opcode, 'N', 64);
+}
+
+const char* latency_model::FUName(unsigned int fu) {
+	return (fu < NUM_FU_CLASSES) ? fuNames[fu] : "NONE";
+}
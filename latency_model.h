@@ -0,0 +1,90 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for latency_model.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _LATENCY_MODEL_H_
+#define _LATENCY_MODEL_H_ 1
+
+#include "loop_graph_analysis.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+typedef struct
+{
+	int16_t latency;	//cycles until the result can be used
+	uint8_t ii;	//initiation interval: cycles before the unit takes the next operation
+	uint8_t fu;	//fu_class
+}latency_entry;
+
+// Latency, initiation interval and functional unit of every operation, looked up
+// by opcode, type class (N integer, F floating point, V vector) and bit width.
+// GEP expansion nodes have opcodes of their own behind the LLVM ones. The table
+// holds one 4 byte entry per combination and is filled once, so a lookup is a
+// single index computation. Without a file every operation takes 1 cycle on
+// the unit of its kind, PHIs take none; Load() overrides that line by line:
+//
+//	# opcode	type	width	latency	ii	fu
+//	mul	N	*	3	1	MUL
+//	fdiv	F	64	20	20	FP
+//	GEP_MULT	*	*	1	1	MUL
+//
+// opcode is an LLVM opcode name (as in the IR) or GEP_ADD, GEP_MULT, GEP_SHL;
+// type is N, F, V or *; width is 8, 16, 32, 64, 128 or * and is rounded up to
+// the next of these (pointers count as 64); fu is ALU, MUL, MEM, FP or NONE.
+// Later lines override earlier ones, so general lines go first. An operation
+// is looked up by the class and width of its result, a store and a compare by
+// those of operand 0, the value stored or compared: a store of a double is F 64
+// and an fcmp of <4 x float> is V 32, whatever the type of the result.
+class latency_model
+{
+	public:
+		latency_model();	//the default model
+
+		bool Load(const std::string& fileName, std::string& error);	//false with a message naming the line on failure
+
+		const latency_entry& Lookup(unsigned int opcode, char type, unsigned int width) const {
+			return table[(opcode * NUM_TYPES + TypeIndex(type)) * NUM_WIDTHS + WidthIndex(width)];
+		}
+		const latency_entry& LookupGEP(gep_nodeType gepNodeType) const;	//the expansion nodes work on 64 bit integers
+
+		const std::vector<latency_entry>& Table() const { return table; }	//e.g. to fingerprint the model
+
+		static const char* FUName(unsigned int fu);
+
+	private:
+		enum { NUM_TYPES = 3, NUM_WIDTHS = 5 };
+		std::vector<latency_entry> table;
+		unsigned int nOpcodes;	//LLVM opcodes and the GEP opcodes behind them
+
+		static unsigned int TypeIndex(char type) { return (type == 'F') ? 1 : (type == 'V') ? 2 : 0; }
+		static unsigned int WidthIndex(unsigned int width) {	//0 (pointers) counts as 64
+			return (width == 0) ? 3 : (width <= 8) ? 0 : (width <= 16) ? 1 : (width <= 32) ? 2 : (width <= 64) ? 3 : 4;
+		}
+		void Set(unsigned int opcode, int type, int width, const latency_entry& entry);	//-1: every type or width
+};
+
+#endif //_LATENCY_MODEL_H_
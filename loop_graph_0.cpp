@@ -26,12 +26,19 @@
  */
 
 
+#define DEBUG_TYPE "loop-graph-analysis-0"
 #include "llvm/Pass.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/ScalarEvolution.h"
-#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/DebugInfo.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/ErrorHandling.h"
 #include <map>
 #include <list>
 #include "llvm/Analysis/CallGraph.h"
@@ -41,16 +48,32 @@
 #include "llvm/Analysis/PostDominators.h"
 #include <assert.h>
 #include "llvm/IR/Type.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/MathExtras.h"
 #include <stdio.h>
-#include "llvm/Analysis/DependenceAnalysis.h"
+#include <stdlib.h>
 #include "llvm/ADT/SmallBitVector.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
+#include "work_pool.h"
+#include "graph_emitter.h"
+#include "dfg_cache.h"
+#include "latency_model.h"
+#include "graph_opt.h"
+#include "modulo_schedule.h"
+#include "cgra_map.h"
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <stdarg.h>
+#include <sys/resource.h>
  #include "llvm/ADT/SmallBitVector.h"
 
-#define NINTERVALS (100)
-#define PRINT_THRESH (0)
-#define COV (1)
-#define ENTRY_POINT(a) printf(" in %s \n", a);getchar();getchar();getchar();
 #define stringify( name ) # name
 
 using namespace llvm;
@@ -79,115 +102,613 @@ const char* typeNames[] = {
 "FirstDerivedTyID"
 };
 
-map <unsigned int, clust_graph> graphs;
-
-unsigned int nodeID = 0;
-unsigned int edgeID = 0;
+STATISTIC(NumLoopGraphs, "Loop graphs built");
+STATISTIC(NumGraphNodes, "Nodes in the final loop graphs");
+STATISTIC(NumGraphEdges, "Edges in the final loop graphs");
+STATISTIC(NumDataNodes, "Data nodes for values from outside the loops");
+STATISTIC(NumGEPsExpanded, "GEP instructions expanded");
+STATISTIC(NumBackEdges, "Loop-carried edges, left out of the levels of the loop graphs");
+STATISTIC(NumBytesWritten, "Bytes of loop graph files written, before compression");
+STATISTIC(NumGraphAllocations, "Heap allocations made for loop graph storage");
+STATISTIC(NumLoopsSkipped, "Innermost loops left out by the loop selection");
+STATISTIC(NumCacheHits, "Loop graphs reused from the cache");
+STATISTIC(NumMemDeps, "Memory dependence edges between loads and stores");
+STATISTIC(NumMemDepQueries, "Pairs of memory operations given to DependenceAnalysis");
+STATISTIC(NumMemDepLoopsSkipped, "Loops with more memory operations than -dfg-mem-dep-limit");
+STATISTIC(NumAffineAccesses, "Loads and stores given an affine address");
+STATISTIC(NumAddressInsElided, "Address computations of affine loads and stores left out");
+STATISTIC(NumOptNodesRemoved, "Nodes removed by the optimization passes of the final loop graphs");
+STATISTIC(NumOptEdgesRemoved, "Edges removed by the optimization passes of the final loop graphs");
+STATISTIC(NumLoopsScheduled, "Loop graphs given a modulo schedule");
+STATISTIC(NumScheduleTimeouts, "Loop graphs whose modulo schedule ran out of time");
+STATISTIC(NumLoopsMapped, "Loop graphs placed and routed on the CGRA");
+STATISTIC(NumMapFailures, "Loop graphs that could not be mapped onto the CGRA");
 
 namespace {
 
-	map <unsigned int, double> topLoops;
+	cl::opt<unsigned int> DFGThreads("dfg-threads", cl::init(1),
+			cl::desc("Threads building loop graphs, 0 for one per processor"));
+
+	cl::bits<emit_format> DFGFormat("dfg-format", cl::CommaSeparated,
+			cl::desc("Loop graph files to write (default text,dot)"),
+			cl::values(
+				clEnumValN(EMIT_TEXT, "text", "tab separated .graph file"),
+				clEnumValN(EMIT_DOT, "dot", "graphviz .dot file"),
+				clEnumValN(EMIT_BINARY, "binary", "memory-mappable .dfgb file, see dfg_binary.h"),
+				clEnumValN(EMIT_JSON, "json", ".json file"),
+				clEnumValN(EMIT_GRAPHML, "graphml", ".graphml file"),
+				clEnumValEnd));
+
+	cl::opt<bool> DFGCompress("dfg-compress", cl::init(false),
+			cl::desc("Compress the text loop graph files with zlib, adding .gz to their names"));
+
+	cl::opt<bool> DFGMemReport("dfg-mem-report", cl::init(false),
+			cl::desc("Report the peak memory of the process and of the largest loop graph"));
+
+	cl::opt<bool> DFGTime("dfg-time", cl::init(false),
+			cl::desc("Time the phases of loop graph construction with LLVM timers (single thread only)"));
+
+	cl::opt<string> DFGReport("dfg-report", cl::init(""), cl::value_desc("file"),
+			cl::desc("Write phase times and counters per loop and per module to a JSON file"));
+
+	cl::opt<bool> DFGQuiet("dfg-quiet", cl::init(false),
+			cl::desc("Do not list the loop instructions on stdout"));
+
+	cl::opt<string> DFGLatency("dfg-latency", cl::init(""), cl::value_desc("file"),
+			cl::desc("Latency, initiation interval and functional unit of the operations, see latency_model.h"));
+
+	cl::opt<bool> DFGMemDeps("dfg-mem-deps", cl::init(true),
+			cl::desc("Add memory dependence edges between loads and stores, from DependenceAnalysis"));
+
+	cl::opt<unsigned int> DFGMemDepLimit("dfg-mem-dep-limit", cl::init(512),
+			cl::desc("Leave out the memory dependences of loops with more loads and stores, every pair is a query"));
+
+	cl::opt<bool> DFGAffine("dfg-affine", cl::init(false),
+			cl::desc("Give loads and stores with an affine address base, stride and trip count, leaving out their address computation"));
+
+	cl::list<opt_pass_kind> DFGOpt("dfg-opt", cl::CommaSeparated,
+			cl::desc("Optimization passes of the final loop graph, run in the order given, see graph_opt.h"),
+			cl::values(
+				clEnumValN(OPT_DCE, "dce", "remove nodes whose results are not used"),
+				clEnumValN(OPT_CSE, "cse", "merge nodes that compute the same operation of the same operands"),
+				clEnumValN(OPT_FOLD, "fold", "fold integer and floating point constants into immediates"),
+				clEnumValN(OPT_FUSE, "fuse", "fuse mul+add, fmul+fadd, icmp+select and fcmp+select"),
+				clEnumValEnd));
+
+	cl::opt<bool> DFGSchedule("dfg-schedule", cl::init(false),
+			cl::desc("Modulo schedule the final loop graph and write the cycle of every operation"));
+
+	cl::list<string> DFGUnits("dfg-units", cl::CommaSeparated, cl::value_desc("class=n,..."),
+			cl::desc("Functional units of each class for -dfg-schedule (default ALU=4,MUL=2,MEM=2,FP=2)"));
+
+	cl::opt<unsigned int> DFGScheduleBudget("dfg-schedule-budget", cl::init(1000), cl::value_desc("ms"),
+			cl::desc("Wall clock milliseconds the modulo schedule of one loop may take, 0 for no limit"));
+
+	cl::opt<bool> DFGMap("dfg-map", cl::init(false),
+			cl::desc("Place and route the final loop graph on a CGRA and write the mapping"));
+
+	cl::opt<string> DFGCGRA("dfg-cgra", cl::init(""), cl::value_desc("file"),
+			cl::desc("Grid of the CGRA for -dfg-map, see cgra_map.h (default 4x4 mesh); implies -dfg-map"));
 
+	cl::opt<unsigned int> DFGMapRestarts("dfg-map-restarts", cl::init(8),
+			cl::desc("Annealing runs for each II of -dfg-map, on the threads the loops leave free"));
+
+	cl::opt<unsigned int> DFGMapBudget("dfg-map-budget", cl::init(10000), cl::value_desc("ms"),
+			cl::desc("Wall clock milliseconds the mapping of one loop may take, 0 for no limit"));
+
+	cl::opt<string> DFGCache("dfg-cache", cl::init(""), cl::value_desc("dir"),
+			cl::desc("Reuse the files of loops that did not change since an earlier run, kept in this directory"));
+
+	// Loop selection. A loop is built only if it passes every filter that is set; loop
+	// ids stay those of the whole module, so a selected loop keeps its file names.
+	cl::opt<double> DFGMinCoverage("dfg-min-coverage", cl::init(0),
+			cl::desc("Build only loops with at least this share of the dynamic instructions of the module"));
+
+	cl::opt<unsigned int> DFGTop("dfg-top", cl::init(0),
+			cl::desc("Build only the N loops with the highest coverage, 0 for all"));
+
+	cl::opt<string> DFGFunction("dfg-function", cl::init(""), cl::value_desc("regex"),
+			cl::desc("Build only loops in functions whose name matches"));
+
+	cl::opt<string> DFGLocation("dfg-location", cl::init(""), cl::value_desc("regex"),
+			cl::desc("Build only loops whose header location file:line matches (needs debug info)"));
+
+	cl::list<unsigned int> DFGLoops("dfg-loops", cl::CommaSeparated, cl::value_desc("id,id,..."),
+			cl::desc("Build only the loops with these ids"));
 
 	unsigned int loopID = 0;
+	sys::Mutex outputLock;	//keeps the stdout output of a loop together
+
+	latency_model latencyModel;	//read only once the pass runs
+	uint64_t latencyFingerprint = 0;	//hash of its table, part of the cache key
+
+	graph_pipeline optPipeline;	//the passes of -dfg-opt, set up once the pass runs
+
+	modulo_scheduler* scheduler = 0;	//with -dfg-schedule
+	cgra_mapper* mapper = 0;	//with -dfg-map
+
+	loop_cache* graphCache = 0;	//with -dfg-cache
+	unsigned int cacheHits = 0;	//guarded by statsLock
+	unsigned int cacheMisses = 0;
+
+	enum dfg_phase {
+		PHASE_FORM_NODES,
+		PHASE_DATA_EDGES,
+		PHASE_CTRL_EDGES,
+		PHASE_MEM_EDGES,
+		PHASE_REMOVE_CYCLE,
+		PHASE_LEVELIZE,
+		PHASE_REMOVE_GEP,
+		PHASE_OPTIMIZE,
+		PHASE_SCHEDULE,
+		PHASE_MAP,
+		PHASE_EMIT,
+		NUM_PHASES
+	};
 
-	class LoopGraphAnalysisPass_0 : public FunctionPass {
+	const char* phaseNames[NUM_PHASES] = {
+		"FormNodes",
+		"AddDataEdges",
+		"AddCtrlEdges",
+		"AddMemEdges",
+		"RemoveCycle",
+		"Levelize",
+		"RemoveGEP",
+		"Optimize",
+		"Schedule",
+		"Map",
+		"Emit"
+	};
 
-		public:
+	TimerGroup phaseTimerGroup("DFGenTool loop graph phases");
+	Timer phaseTimers[NUM_PHASES];	//LLVM timers are not thread safe, they are used when building on one thread
+	bool useTimers = false;
+
+	typedef struct
+	{
+		unsigned int id;	//loop id
+		double cov;	//coverage of the loop
+		unsigned int criticalPath;	//cycles, see clust_graph::Levelize
+		unsigned int nodes;	//live nodes and edges of the final graph
+		unsigned int edges;
+		unsigned int dataNodes;
+		unsigned int gepsExpanded;
+		unsigned int backEdges;
+		unsigned int memDeps;	//memory dependence edges
+		unsigned int affineAccesses;	//loads and stores with an affine address
+		unsigned int addressElided;	//instructions left out as their address computation
+		unsigned int recMII;	//see clust_graph::RecMII
+		unsigned int optNodes[NUM_OPT_PASSES];	//live nodes and edges removed by each optimization pass
+		unsigned int optEdges[NUM_OPT_PASSES];
+		unsigned int resMII;	//of the modulo schedule, see loop_schedule
+		unsigned int scheduleRecMII;
+		unsigned int ii;
+		unsigned int stages;
+		bool timedOut;
+		unsigned int mapResMII;	//of the CGRA mapping, see loop_mapping
+		unsigned int mapRecMII;
+		unsigned int mapII;
+		double fuUse;
+		double linkUse;
+		double registerUse;
+		bool mapTimedOut;
+		unsigned int allocations;
+		unsigned long long bytesWritten;
+		double time[NUM_PHASES];	//wall clock seconds
+		bool cached;	//the files were taken from the cache
+	}loop_stats;
+
+	sys::Mutex statsLock;	//guards loopStats
+	vector <loop_stats> loopStats;	//per loop, for the report
+
+	long PeakRSSKB() {
+		struct rusage usage;
+		return (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : -1;	//kilobytes on Linux
+	}
+
+	sys::Mutex memLock;	//guards the memory counters below
+	size_t maxGraphBytes = 0;	//largest loop graph built so far
+	unsigned int maxGraphLoop = 0;	//loop it belongs to
+	unsigned int nGraphs = 0;	//loop graphs built and released
+
+	struct HotterLoop {
+		bool operator() (const pair<double, unsigned int>& a, const pair<double, unsigned int>& b) const {
+			if (a.first != b.first) return a.first > b.first;
+			return a.second < b.second;
+		}
+	};
 
-			static char ID; 		// Class identification, replacement for typeinfo.
-			LoopInfo* LI;
-			double totWt;
-			double sumWt;
-			double wt;
+	struct CtrlDepLess {
+		bool operator() (const loop_ctrl_dep& a, const loop_ctrl_dep& b) const {
+			if (a.branch != b.branch) return a.branch < b.branch;
+			return a.dependent < b.dependent;
+		}
+	};
 
+	struct MemDepLess {
+		bool operator() (const loop_mem_dep& a, const loop_mem_dep& b) const {
+			if (a.src != b.src) return a.src < b.src;
+			return a.dst < b.dst;
+		}
+	};
 
-			explicit LoopGraphAnalysisPass_0() : FunctionPass(ID) {}
+	struct StatsLess {
+		bool operator() (const loop_stats& a, const loop_stats& b) const {
+			return a.id < b.id;
+		}
+	};
 
+	unsigned int AddressOperand(Value* ins) {	//operand of a load or store that holds the address
+		return isa<StoreInst>(ins) ? StoreInst::getPointerOperandIndex() : LoadInst::getPointerOperandIndex();
+	}
 
-			void getAnalysisUsage(AnalysisUsage &AU) const {
-				AU.setPreservesAll();
-				AU.addRequired<PostDominatorTree>();
-				AU.addRequired<LoopInfo>();
-				AU.addRequired<DependenceAnalysis>();
-				AU.addPreserved<DependenceAnalysis>();
-				AU.addRequired<ScalarEvolution>();
-				AU.addPreserved<ScalarEvolution>();
-				AU.addRequired<AliasAnalysis>();
-				AU.addPreserved<AliasAnalysis>();
-				AU.addRequired<MemoryDependenceAnalysis>();
-				AU.addPreserved<MemoryDependenceAnalysis>();
-			}
+	class LoopGraphBuilder {	//builds, transforms and writes the graph of one innermost loop
 
-			virtual bool doInitialization(Module& M) {	//doInitialization
-				return false;
+		public:
+
+			explicit LoopGraphBuilder(const loop_task& loopTask) : task(loopTask), nodeID(0), edgeID(0), sumWt(0),
+				timing(useTimers || !DFGReport.empty()) {
+				memset(&stats, 0, sizeof(stats));
+				stats.id = task.id;
+				stats.cov = task.cov;
 			}
 
+			void Run() {
+				if (!DFGQuiet) PrintLoop();	//print loop
 
-			virtual bool runOnFunction(Function& F) {
-				LI = &getAnalysis<LoopInfo>();
-				for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I)	//gives the collection of Loops
-					ProcessLoop(*I);
-				return false;
-			}
+				uint64_t key = 0;
+				if (graphCache) {	//a loop that did not change needs no graph
+					key = loop_cache::Key(task, CacheConfig());
+					if (FetchCached(key)) {
+						sys::ScopedLock guard(outputLock);
+						fputs(chatter.c_str(), stdout);
+						return;
+					}
+				}
 
+				StartPhase(PHASE_FORM_NODES);
+				if (!FormNodes(task.id)) {	//iterate over the loop instructions and form nodes for instructions
+					Report("loop failed %.5lf\n", task.cov);
+				}
+				StopPhase(PHASE_FORM_NODES);
+
+				StartPhase(PHASE_DATA_EDGES);
+				AddDataEdges(task.id);	//introduce data dependence edges into graph
+				StopPhase(PHASE_DATA_EDGES);
+
+				StartPhase(PHASE_CTRL_EDGES);
+				AddCtrlEdges(task.id);	//introduce control dependence edges into graph
+				StopPhase(PHASE_CTRL_EDGES);
+
+				StartPhase(PHASE_MEM_EDGES);
+				AddMemEdges(task.id);	//memory dependences found when the loop was collected
+				StopPhase(PHASE_MEM_EDGES);
+
+				StartPhase(PHASE_REMOVE_CYCLE);
+				RemoveCycle(graph);
+				StopPhase(PHASE_REMOVE_CYCLE);
+
+				StartPhase(PHASE_LEVELIZE);	//ASAP/ALAP levels of the acyclic graph, weighted by latency
+				stats.criticalPath = graph.Levelize();
+				StopPhase(PHASE_LEVELIZE);
+
+				emit_loop loop;	//the .graph file shows the graph as it is now
+				loop.id = task.id;
+				loop.cov = task.cov;
+				loop.maxDepth = stats.criticalPath;
+				loop.recMII = stats.recMII;
+				loop.tripCount = task.tripCount;
+				loop.graphNodes = graph.NumNodes();
+				loop.graphEdges = graph.NumEdges();
+
+				StartPhase(PHASE_REMOVE_GEP);
+				RemoveGEP(task.id);
+				StopPhase(PHASE_REMOVE_GEP);
+
+				if (optPipeline.NumPasses()) {
+					StartPhase(PHASE_OPTIMIZE);
+					Optimize();
+					StopPhase(PHASE_OPTIMIZE);
+				}
+				loop.immediates = Immediates();
 
-			bool ProcessLoop(Loop* L) {
-				for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I) {
-					ProcessLoop(*I);
+				unsigned int recMII = 0;	//recurrences of the final graph
+				if (scheduler || mapper) {
+					ResetSearch(graph);
+					graph.FindRecurrences();
+					recMII = graph.RecMII();
 				}
 
-				map <unsigned int, double>::iterator topLoopIter = topLoops.find(loopID);  //check if current loop is a top loop
+				loop.schedule = 0;
+				if (scheduler) {
+					StartPhase(PHASE_SCHEDULE);
+					Schedule(recMII);
+					StopPhase(PHASE_SCHEDULE);
+					loop.schedule = &schedule;
+				}
 
-				if(L->getSubLoops().size()==0) {	//check if current loop is the innermost loop
-					PrintLoop(L);	//print loop
-					if (!FormNodes(L,loopID)) {	//iterate over the loop instructions and form nodes for instructions
-						printf("loop failed %.5lf\n", topLoopIter->second);
-					}
+				loop.mapping = 0;
+				if (mapper) {
+					StartPhase(PHASE_MAP);
+					Map(recMII);
+					StopPhase(PHASE_MAP);
+					loop.mapping = &mapping;
+				}
 
-					AddDataEdges(L, loopID);	//introduce data dependence edges into graph
+				StartPhase(PHASE_EMIT);
+				string errors;	//write all files in one walk over the graph
+				graph_emitter emitter(Formats(), DFGCompress);
+				bool written = emitter.Emit(graph, loop, errors);
+				if (!written) chatter += errors;
+				stats.bytesWritten = emitter.BytesWritten();
+				StopPhase(PHASE_EMIT);
 
-					AddCtrlEdges(L, loopID);	//introduce control dependence edges into graph
+				if (graphCache && written && !stats.timedOut && !stats.mapTimedOut) StoreCached(key, emitter.FilesWritten());	//another try may find the schedule or mapping
 
-					bool success = WriteLoopGraph(loopID, topLoopIter->second);
+				NoteGraphBytes();
+				NoteStats();
 
-					if(success) {
-						list<clust_node> *gepNodes = new list<clust_node>;
-						RemoveGEP(gepNodes, loopID);
-						PrintDotGraph (gepNodes, loopID);
-					}
+				sys::ScopedLock guard(outputLock);	//keep the output of a loop together
+				fputs(chatter.c_str(), stdout);
+			}	//the graph is released with the builder, only one loop graph per thread is alive
+
+		private:
+
+			const loop_task& task;
+			unsigned int nodeID;	//ids are numbered per loop
+			unsigned int edgeID;
+			double sumWt;	//dynamic instructions of the loop per call of its function
+			string chatter;	//stdout output of this loop
+			clust_graph graph;	//graph of the loop, owned by the builder
+			vector<unsigned int> insNode;	//node of each instruction of the loop, by position; ~0U if it was elided
+			bool timing;	//phases are timed
+			TimeRecord phaseStart;
+			loop_stats stats;
+			loop_schedule schedule;	//of the final graph, with -dfg-schedule
+			loop_mapping mapping;	//of the final graph, with -dfg-map
+
+			void Print(const char* format, ...) {	//progress output, left out with -dfg-quiet
+				if (DFGQuiet) return;
+				va_list args;
+				va_start(args, format);
+				Append(format, args);
+				va_end(args);
+			}
+
+			void Report(const char* format, ...) {	//output that is always shown
+				va_list args;
+				va_start(args, format);
+				Append(format, args);
+				va_end(args);
+			}
+
+			void Append(const char* format, va_list args) {
+				char buf[256];
+				vsnprintf(buf, sizeof(buf), format, args);
+				chatter += buf;
+			}
+
+			void StartPhase(dfg_phase phase) {
+				if (!timing) return;
+				if (useTimers) phaseTimers[phase].startTimer();
+				phaseStart = TimeRecord::getCurrentTime(true);
+			}
+
+			void StopPhase(dfg_phase phase) {
+				if (!timing) return;
+				TimeRecord elapsed = TimeRecord::getCurrentTime(false);
+				elapsed -= phaseStart;
+				stats.time[phase] += elapsed.getWallTime();
+				if (useTimers) phaseTimers[phase].stopTimer();
+			}
+
+			void NoteStats() {	//add the counters of this loop to the statistics and the report
+				if (!stats.cached) {
+					stats.nodes = graph.NumLiveNodes();
+					stats.edges = graph.NumLiveEdges();
+					stats.allocations = graph.NumAllocations();
+					NumLoopGraphs ++;
 				}
+				else NumCacheHits ++;
+
+				NumGraphNodes += stats.nodes;
+				NumGraphEdges += stats.edges;
+				NumDataNodes += stats.dataNodes;
+				NumGEPsExpanded += stats.gepsExpanded;
+				NumBackEdges += stats.backEdges;
+				NumMemDeps += stats.memDeps;
+				NumAffineAccesses += stats.affineAccesses;
+				NumAddressInsElided += stats.addressElided;
+				for (unsigned int k = 0; k < NUM_OPT_PASSES; k ++) {
+					NumOptNodesRemoved += stats.optNodes[k];
+					NumOptEdgesRemoved += stats.optEdges[k];
+				}
+				if (stats.ii) NumLoopsScheduled ++;
+				if (stats.timedOut) NumScheduleTimeouts ++;
+				if (mapper && stats.mapII) NumLoopsMapped ++;
+				if (mapper && !stats.mapII && !stats.mapTimedOut) NumMapFailures ++;
+				NumBytesWritten += stats.bytesWritten;
+				NumGraphAllocations += stats.allocations;
+
+				if (DFGReport.empty()) return;
+				sys::ScopedLock guard(statsLock);
+				loopStats.push_back(stats);
+			}
 
-				loopID ++;
-				nodeID = 0; //reset
-				edgeID = 0;
+			static string CacheConfig() {	//the options that change the files of a loop
+				char config[64];
+				snprintf(config, sizeof(config), "formats=%u compress=%d latency=%016llx", Formats(),
+						DFGCompress && CompressionAvailable(), (unsigned long long)latencyFingerprint);
+				string options = config;
+				for (unsigned int p = 0; p < optPipeline.NumPasses(); p ++)
+					options += string(p ? "," : " opt=") + graph_pipeline::PassName(optPipeline.Kind(p));
+				for (unsigned int c = 0; scheduler && c < NUM_FU_CLASSES; c ++) {	//the budget only decides whether there is a schedule
+					if (c == FU_NONE) continue;
+					snprintf(config, sizeof(config), "%s%s=%u", (c == FU_NONE + 1) ? " schedule=" : ",", latency_model::FUName(c),
+							scheduler->Config().units[c]);
+					options += config;
+				}
+				if (mapper) {	//the threads and the budget only decide whether there is a mapping
+					snprintf(config, sizeof(config), " cgra=%016llx restarts=%u", (unsigned long long)mapper->Grid().Fingerprint(),
+							mapper->Config().restarts);
+					options += config;
+				}
+				return options;
+			}
 
-				return false;
+			bool FetchCached(uint64_t key) {
+				cache_entry entry;
+				bool hit = graphCache->Fetch(key, task.id, task.cov, entry);
+				{
+					sys::ScopedLock guard(statsLock);
+					if (hit) cacheHits ++;
+					else cacheMisses ++;
+				}
+				if (!hit) return false;
+
+				Print("id = %u\n", task.id);	//as if the graph had been built
+				stats.cached = true;
+				stats.nodes = entry.nodes;
+				stats.edges = entry.edges;
+				stats.dataNodes = entry.dataNodes;
+				stats.gepsExpanded = entry.gepsExpanded;
+				stats.backEdges = entry.backEdges;
+				stats.memDeps = entry.memDeps;
+				stats.affineAccesses = entry.affineAccesses;
+				stats.addressElided = entry.addressElided;
+				stats.recMII = entry.recMII;
+				for (unsigned int k = 0; k < NUM_OPT_PASSES; k ++) {
+					stats.optNodes[k] = entry.optNodes[k];
+					stats.optEdges[k] = entry.optEdges[k];
+				}
+				stats.resMII = entry.resMII;
+				stats.scheduleRecMII = entry.scheduleRecMII;
+				stats.ii = entry.ii;
+				stats.stages = entry.stages;
+				stats.mapResMII = entry.mapResMII;
+				stats.mapRecMII = entry.mapRecMII;
+				stats.mapII = entry.mapII;
+				stats.fuUse = entry.fuUse;
+				stats.linkUse = entry.linkUse;
+				stats.registerUse = entry.registerUse;
+				stats.criticalPath = entry.criticalPath;
+				stats.bytesWritten = entry.bytesWritten;
+				NoteStats();
+				return true;
 			}
 
-		private:
+			void StoreCached(uint64_t key, const vector<string>& files) {
+				cache_entry entry;
+				entry.nodes = graph.NumLiveNodes();
+				entry.edges = graph.NumLiveEdges();
+				entry.dataNodes = stats.dataNodes;
+				entry.gepsExpanded = stats.gepsExpanded;
+				entry.backEdges = stats.backEdges;
+				entry.memDeps = stats.memDeps;
+				entry.affineAccesses = stats.affineAccesses;
+				entry.addressElided = stats.addressElided;
+				entry.recMII = stats.recMII;
+				for (unsigned int k = 0; k < NUM_OPT_PASSES; k ++) {
+					entry.optNodes[k] = stats.optNodes[k];
+					entry.optEdges[k] = stats.optEdges[k];
+				}
+				entry.resMII = stats.resMII;
+				entry.scheduleRecMII = stats.scheduleRecMII;
+				entry.ii = stats.ii;
+				entry.stages = stats.stages;
+				entry.mapResMII = stats.mapResMII;
+				entry.mapRecMII = stats.mapRecMII;
+				entry.mapII = stats.mapII;
+				entry.fuUse = stats.fuUse;
+				entry.linkUse = stats.linkUse;
+				entry.registerUse = stats.registerUse;
+				entry.criticalPath = stats.criticalPath;
+				entry.bytesWritten = stats.bytesWritten;
+				entry.files = files;
+				graphCache->Store(key, task.id, entry);
+			}
 
-			void PrintLoop(Loop* L) {			//print the instructions in the loop
-				for (Loop::block_iterator bi = L->block_begin(), be = L->block_end(); bi != be; bi ++) {		//for each block
-					BasicBlock* bbl = *bi;
+			static unsigned int Formats() {
+				unsigned int formats = DFGFormat.getBits();
+				if (!formats) formats = (1 << EMIT_TEXT) | (1 << EMIT_DOT);
+				return mapper ? formats | (1 << EMIT_MAP) : formats;
+			}
+
+			void NoteGraphBytes() {	//keep track of the largest graph for the memory report
+				size_t bytes = graph.MemoryBytes();
+				if (DFGMemReport) Report("graph memory = %lu bytes in %u allocations\n", (unsigned long)bytes, graph.NumAllocations());
+
+				sys::ScopedLock guard(memLock);
+				if (bytes > maxGraphBytes) {
+					maxGraphBytes = bytes;
+					maxGraphLoop = task.id;
+				}
+				nGraphs ++;
+			}
+
+			void PrintLoop() {			//print the instructions in the loop
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {		//for each block
+					BasicBlock* bbl = task.blocks[b];
 					for (BasicBlock::const_iterator ins = bbl->begin(), ie = bbl->end(); ins != ie; ins++)	{	//for each instruction
-						printf("\t%s\n", ins->getOpcodeName());
+						Print("\t%s\n", ins->getOpcodeName());
+					}
+				}
+			}
+
+			void ReserveGraph() {	//size the graph once from the loop, see clust_graph::Reserve
+				SmallPtrSet<BasicBlock*, 16> inLoop(task.blocks.begin(), task.blocks.end());
+				unsigned int nNodes = 0, nEdges = 0;
+				unsigned int pos = 0;
+				unsigned int gep = 0;	//cursor into task.geps, which is sorted by position
+
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+					BasicBlock* bbl = task.blocks[b];
+					for (BasicBlock::iterator ins = bbl->begin(), ie = bbl->end(); ins != ie; ins++, pos++) {
+						if (Elided(pos)) continue;
+						nNodes ++;
+						nEdges += ins->getNumOperands();	//one data edge per operand
+						for (User::op_iterator opnd = ins->op_begin(), oe = ins->op_end(); opnd != oe; opnd ++) {
+							Instruction* producer = dyn_cast<Instruction>(opnd->get());
+							if (!producer || !inLoop.count(producer->getParent())) nNodes ++;	//at most one data node per outside operand
+						}
+						if (gep < task.geps.size() && task.geps[gep].pos == pos) {	//an add and a scale node per index, the offset, their edges and the rewired ones
+							unsigned int nIndices = task.geps[gep ++].nIndices;
+							nNodes += 2 * nIndices + 1;
+							nEdges += 2 * nIndices + 1 + ins->getNumOperands() + ins->getNumUses();
+						}
 					}
 				}
+
+				for (unsigned int dep = 0; dep < task.ctrlDeps.size(); dep ++)	//at most one control edge per dependent instruction
+					nEdges += task.blocks[task.ctrlDeps[dep].dependent]->size();
+
+				graph.Reserve(nNodes, nEdges);
 			}
 
-			bool FormNodes(Loop* L, unsigned int id) {
-				clust_graph newGraph;
+			bool Elided(unsigned int pos) const {	//instruction only computes affine addresses, see CollectAffineAccesses
+				return pos < task.elided.size() && task.elided.test(pos);
+			}
 
-				for (Loop::block_iterator bi = L->block_begin(), be = L->block_end(); bi != be; bi ++) {
-					BasicBlock* bbl = *bi;
-					for (BasicBlock::iterator ins = bbl->begin(), ie = bbl->end(); ins != ie; ins++) {	//for each ins
+			bool FormNodes(unsigned int id) {
+				ReserveGraph();
+
+				const unsigned int noNode = ~0U;
+				unsigned int pos = 0;
+				unsigned int access = 0;	//cursor into task.accesses, which is sorted by position
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+					BasicBlock* bbl = task.blocks[b];
+					for (BasicBlock::iterator ins = bbl->begin(), ie = bbl->end(); ins != ie; ins++, pos++) {	//for each ins
+						if (Elided(pos)) {
+							insNode.push_back(noNode);
+							continue;
+						}
 
-						clust_node newNode;
-						newNode.ins = &*ins;
-						newNode.id = ++ nodeID ;
+						unsigned int n = graph.AddNode(&*ins, true);
+						insNode.push_back(n);
+						graph.SetNodeID(n, ++ nodeID);
+						clust_node& newNode = graph.Node(n);
 						newNode.entryNode = false;
-						newNode.wt = wt;
+						newNode.wt = task.blockWt[b];	//the instruction executes as often as its block
 						newNode.nodeType = INSTNODE;
 						newNode.depth = 0;
 
@@ -230,571 +751,1221 @@ namespace {
 						}
 						else newNode.isLoad = false;
 
-						if(((Instruction*)(&*ins))->getOpcode() == Instruction::PHI) {		// PHI instruction can execute if any
-															// of the operands are available.
-							newNode.ifAny = true;
-							newNode.latency = 0;
+						if (access < task.accesses.size() && task.accesses[access].pos == pos) {	//its address comes from an address unit
+							newNode.access = &task.accesses[access];
+							access ++;
 						}
-						else
-						{
-							newNode.ifAny = false;		//instruction executes when both the operands are available
-							newNode.latency = 1;		//every node except PHI have latency 1
 
+						// PHI instruction can execute if any of the operands are available, others when all are
+						newNode.ifAny = (((Instruction*)(&*ins))->getOpcode() == Instruction::PHI);
+
+						Type* opTyp = (&*ins)->getType();	//a store works on the value it stores, a compare on its operands
+						char opClass = t;
+						if (isa<StoreInst>(&*ins) || isa<CmpInst>(&*ins)) {
+							opTyp = ins->getOperand(0)->getType();
+							opClass = opTyp->isVectorTy() ? 'V' : opTyp->isFPOrFPVectorTy() ? 'F' : 'N';
 						}
+						const latency_entry& lat = latencyModel.Lookup(ins->getOpcode(), opClass, opTyp->getScalarSizeInBits());
+						newNode.latency = lat.latency;
+						newNode.ii = lat.ii;
+						newNode.fu = (fu_class)lat.fu;
 
-						newGraph.insert(pair <Value*, clust_node> (&*ins, newNode));
-						sumWt = sumWt + wt;
+						sumWt = sumWt + newNode.wt;
 
 					}//for each ins
 				}//for each block
 
-				graphs.insert (pair <unsigned int, clust_graph> (id, newGraph));
+				stats.affineAccesses = task.accesses.size();
+				stats.addressElided = task.elided.count();
 				return true;
 			}//FormNodes
 
 
-			void AddDataEdges (Loop* L, unsigned int id) {		//Insert data dependent edges from producer to consumer instructions
-				printf("id = %u\n",id);		//print graph id
-				map <unsigned int, clust_graph>::iterator loopGraph = graphs.find (id);
-				assert (loopGraph != graphs.end());
+			void AddDataEdges (unsigned int id) {		//Insert data dependent edges from producer to consumer instructions
+				Print("id = %u\n",id);		//print graph id
 
-				for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++) { //for each node
-					if (nodeIter->second.nodeType == DATANODE) continue;
-					Value* ins = nodeIter->second.ins;
+				// visit the instructions in program order, block by block, and their operands in
+				// operand order, so data nodes and edges are numbered the same in every run
+				unsigned int nIns = graph.NumNodes();	//data nodes are added behind the instructions
+				for (unsigned int node = 0; node < nIns; node ++) { //for each node
+					Value* ins = graph.Node(node).ins;
+					bool header = isa<PHINode>(ins) && (((Instruction*)ins)->getParent() == task.blocks[0]);	//operands from inside the loop arrive over the back-edge
 					for (User::op_iterator opnd = ((Instruction*)ins)->op_begin(), oe = ((Instruction*)ins)->op_end(); opnd != oe; opnd ++) { //for each use
+						if (graph.Node(node).access && opnd->getOperandNo() == AddressOperand(ins)) continue;	//the address unit computes it
 						Value* val = opnd->get();
-						map<Value*, clust_node>::iterator target = loopGraph->second.find(val);		//check if use is in the graph
+						int target = graph.Find(val);		//check if use is in the graph
 
-						if (target != loopGraph->second.end()) {	//use is in the graph and is being produced by some instruction
+						if (target >= 0) {	//use is in the graph and is being produced by some instruction
+							bool carried = header && (graph.Node(target).nodeType == INSTNODE);
 
 							edgeID ++;	//form edge
-							clust_edge newEdge;
-							newEdge.target = &(nodeIter->second);
-							newEdge.depType = DATADEP;
-							newEdge.wt = nodeIter->second.wt;
-							newEdge.id = edgeID;
-							newEdge.backEdge = false;
-							target->second.edges.push_back(newEdge);
-
-							clust_edge outEdge;
-							outEdge.target = &(target->second);
-							outEdge.depType = DATADEP;
-							outEdge.wt = nodeIter->second.wt;
-							outEdge.id = edgeID;
-							outEdge.backEdge = false;
-							nodeIter->second.outgoingEdges.push_back(outEdge);
-
-							if (target->second.nodeType == DATANODE) target->second.wt = target->second.wt + nodeIter->second.wt; //if producer is a data node, update its weight
+							unsigned int e = graph.AddEdge(target, node, DATADEP, graph.Node(node).wt, edgeID);
+							if (carried) graph.Edge(e).distance = 1;	//the value of the previous iteration
+
+							if (graph.Node(target).nodeType == DATANODE) graph.Node(target).wt = graph.Node(target).wt + graph.Node(node).wt; //if producer is a data node, update its weight
 						}
 
 						else {		//data coming from outside, add a data node to the graph
 
-							clust_node newNode;
-							newNode.ins = val;
-							newNode.id = ++ nodeID ;
+							target = graph.AddNode(val, true);	//insert
+							graph.SetNodeID(target, ++ nodeID);
+							clust_node& newNode = graph.Node(target);
 							newNode.entryNode = false;
-							newNode.wt = nodeIter->second.wt;
+							newNode.wt = graph.Node(node).wt;
 							newNode.nodeType = DATANODE;
 							newNode.depth = 0;
-
-							loopGraph->second.insert(pair <Value*, clust_node> (val, newNode));	//insert
-							target = loopGraph->second.find(val);
-							assert (target != loopGraph->second.end());
+							newNode.latency = 0;	//the value is there when the loop starts
+							newNode.ii = 0;
+							newNode.fu = FU_NONE;
+							stats.dataNodes ++;
 
 							edgeID ++;	//add an edge
-							clust_edge newEdge;
-							newEdge.target = &(nodeIter->second);
-							newEdge.depType = DATADEP;
-							newEdge.wt = nodeIter->second.wt;
-							newEdge.id = edgeID;
-							newEdge.backEdge = false;
-							target->second.edges.push_back(newEdge);
-
-							clust_edge outEdge;
-							outEdge.target = &(target->second);
-							outEdge.depType = DATADEP;
-							outEdge.wt = nodeIter->second.wt;
-							outEdge.id = edgeID;
-							outEdge.backEdge = false;
-							nodeIter->second.outgoingEdges.push_back(outEdge);
+							graph.AddEdge(target, node, DATADEP, graph.Node(node).wt, edgeID);
 
 						}//data coming from outside
 					}//for each use
 				}//for each ins
+
+				graph.Finalize();
 			}//AddDataEdges
 
 
-			void AddCtrlEdges (Loop* L, unsigned int id) {		//Insert control dependent edges
+			void AddCtrlEdges (unsigned int id) {		//Insert control dependent edges
 
-				PostDominatorTree* PDT = &getAnalysis<PostDominatorTree>();
-				map <unsigned int, clust_graph>::iterator loopGraph = graphs.find (id);		//get loop graph
-				assert (loopGraph != graphs.end());
+				const vector<BasicBlock*>& blocks = task.blocks;
+				unsigned int dep = 0;	//cursor into task.ctrlDeps, which is sorted by branch
 
-				// list to hold instructions that have been found to be control dependent on a 
-				// branch instructions that are data dependent on such instructions and also control 
+				// instructions that have been found to be control dependent on a branch are stamped
+				// with it. Instructions that are data dependent on such instructions and also control
 				// dependent on the same branch need only store the data dependence
 
-				list <Value*> dependents;
+				vector <unsigned int> depStamp(graph.NumNodes(), 0);
+				unsigned int stamp = 0;
+
+				// control dependence edges added so far, threaded per consumer; together with the
+				// data in-edges in the CSR they are all the producers of a node
+				const unsigned int noPred = ~0U;
+				vector <unsigned int> ctrlPredHead(graph.NumNodes(), noPred);
+				vector <pair<unsigned int, unsigned int> > ctrlPreds;	//producer, next
 
-				for (Loop::block_iterator bi = L->block_begin(), be = L->block_end(); bi != be; bi ++) { 	//iterate over blocks for each block
+				for (unsigned int b = 0; b < blocks.size(); b ++) { 	//iterate over blocks for each block
 
-					BasicBlock* bbl = *bi;
-					dependents.clear();
+					BasicBlock* bbl = blocks[b];
 					unsigned int nSucc = 0;		//check that BBL has multiple successors, otherwise nothing is control-dependent on it
 
 					for (succ_iterator succ = succ_begin(bbl), se = succ_end(bbl); succ != se; ++succ) {
 						nSucc ++;
 					}//for each successor block
 
-					if (nSucc <= 1) continue;
-					assert(nSucc == 2);
+					if (nSucc != 2) continue;	//as in ComputeCtrlDeps, only two way branches have dependent blocks
 
 					Value* tail = bbl->getTerminator();	//find terminal instruction of outer block
 					assert (tail);
-					map <Value*, clust_node>::iterator dstNode = loopGraph->second.find(&*tail);
-					assert (dstNode != loopGraph->second.end());
+					int dstNode = graph.Find(&*tail);
+					assert (dstNode >= 0);
 
-					for (Loop::block_iterator biInner = L->block_begin(), beInner = L->block_end(); biInner != beInner; biInner ++) {	//check whether other blocks are control dependent on it
+					while (dep < task.ctrlDeps.size() && task.ctrlDeps[dep].branch < b) dep ++;
+					stamp ++;
 
-						if (*biInner == bbl) continue;		//check distinct blocks
-						bool postDominates = false;
-						succ_iterator dominated = succ_end(bbl);
-						for (succ_iterator succ = succ_begin(bbl), se = succ_end(bbl); succ != se; ++succ) { 	//check if inner block post-dominates at least one of the successors of the outer block
-							bool flag = (PDT->dominates(PDT->getNode(*biInner), PDT->getNode(*succ)));
-							postDominates |= flag;
-							if (flag) dominated = succ;
+					for (; dep < task.ctrlDeps.size() && task.ctrlDeps[dep].branch == b; dep ++) {	//dependent loop blocks in loop order
+						BasicBlock* dependent = blocks[task.ctrlDeps[dep].dependent];
+						clust_dep edgTyp = (task.ctrlDeps[dep].succ == 0) ? CTRLDEP_0 : CTRLDEP_1;	//check which successor is in question
 
-						}
+						for (BasicBlock::iterator ins = dependent->begin(), ie = dependent->end(); ins != ie; ins++) { 	//create a control dep edge from each ins in inner block to terminal ins of outer block
+
+							int srcNode = graph.Find(&*ins);	//find the node for the consumer instr
+							if (srcNode < 0) continue;	//elided address computation
+
+							bool redundant = false;	//first check instruction is not dependent on any instruction already stamped
+							for (unsigned int k = graph.InBegin(srcNode); k != graph.InEnd(srcNode) && !redundant; k ++) {
+								const clust_edge& edge = graph.Edge(graph.InEdge(k));
+								redundant = !edge.removed && (depStamp[edge.src] == stamp);
+							}
+							for (unsigned int p = ctrlPredHead[srcNode]; p != noPred && !redundant; p = ctrlPreds[p].second) {
+								redundant = (depStamp[ctrlPreds[p].first] == stamp);
+							}
+
+							depStamp[srcNode] = stamp;
+							if (redundant) continue;
+
+							edgeID ++;	//create a new edge from the branch to the dependent instruction
+							unsigned int e = graph.AddEdge(dstNode, srcNode, edgTyp, graph.Node(srcNode).wt, edgeID);
+							graph.Edge(e).distance = task.ctrlDeps[dep].distance;
+							ctrlPreds.push_back(make_pair((unsigned int)dstNode, ctrlPredHead[srcNode]));
+							ctrlPredHead[srcNode] = ctrlPreds.size() - 1;
 
-						if ((postDominates) && (!PDT->dominates(PDT->getNode(*biInner), PDT->getNode(bbl)))) {	//check that inner block does not post dominate outer block
-							for (BasicBlock::iterator ins = (*biInner)->begin(), ie = (*biInner)->end(); ins != ie; ins++) { 	//create a control dep edge from each ins in inner block to terminal ins of outer block
-								list <Value*>::iterator depIter = dependents.begin();	//first check instruction is not data dependent on any instruction in the dependents list
-								for (; depIter != dependents.end(); depIter ++) {
+						}//create a control dep edge from each ins in inner block to terminal ins of outer block
+					}//for each control dependent block
+				}//for each block
 
-									map <Value*, clust_node>::iterator producer = loopGraph->second.find (*depIter); 	//find the node for the producer instr
-									assert (producer != loopGraph->second.end());
+				graph.Finalize();
+			}//AddCtrlEdges
 
-									map <Value*, clust_node>::iterator consumer = loopGraph->second.find (&*ins);	//find the node for the consumer instr
-									assert (producer != loopGraph->second.end());
+			void AddMemEdges (unsigned int id) {		//Insert memory dependent edges between loads and stores
+				if (task.memOps > DFGMemDepLimit) Print("memory dependences left out: %u loads and stores\n", task.memOps);
 
-									list <clust_edge>::iterator edgeIter = producer->second.edges.begin();	//check each edge of the producer to see if any of them target the consumer
-									for (; edgeIter != producer->second.edges.end(); edgeIter ++)
-									{
-										if (edgeIter->target == &(consumer->second)) break;
-									}
-									if (edgeIter != producer->second.edges.end()) break;
+				for (unsigned int d = 0; d < task.memDeps.size(); d ++) {
+					const loop_mem_dep& dep = task.memDeps[d];
+					unsigned int src = insNode[dep.src], dst = insNode[dep.dst];	//loads and stores are never elided
+					edgeID ++;
+					unsigned int e = graph.AddEdge(src, dst, dep.kind, graph.Node(dst).wt, edgeID);
+					graph.Edge(e).distance = dep.distance;
+					graph.Edge(e).unknownDistance = dep.unknownDistance;
+				}
+				stats.memDeps = task.memDeps.size();
+
+				graph.Finalize();
+			}//AddMemEdges
+
+			unsigned int AddGEPNode(clust_graph& graph, unsigned int gep, gep_nodeType gepNodeType) {
+				clust_node gepNode = graph.Node(gep);	//a copy, adding a node may move the array
+				unsigned int n = graph.AddNode(gepNode.ins, false);	//GEP nodes share the Value* of the GEP, so they are not keyed
+				graph.SetNodeID(n, ++nodeID);
+				clust_node& newNode = graph.Node(n);
+				newNode.entryNode = false;
+				newNode.wt = gepNode.wt;	//the expansion executes as often as the GEP
+				newNode.nodeType = INSTNODE;
+				newNode.depth = gepNode.depth;	//levels are those of the graph before expansion
+				newNode.slack = gepNode.slack;
+				newNode.gepNode = true;
+				newNode.gepNodeType = gepNodeType;
+				const latency_entry& lat = latencyModel.LookupGEP(gepNodeType);
+				newNode.latency = lat.latency;
+				newNode.ii = lat.ii;
+				newNode.fu = (fu_class)lat.fu;
+				return n;
+			}
 
-								}//first check instruction is not data dependent on any instruction in the dependents list
+			void Optimize() {	//the passes of -dfg-opt on the final graph
+				graph_ids ids;
+				ids.node = nodeID;
+				ids.edge = edgeID;
+				for (unsigned int p = 0; p < optPipeline.NumPasses(); p ++) {
+					opt_pass_kind kind = optPipeline.Kind(p);
+					opt_result result = optPipeline.Run(p, graph, ids);
+					stats.optNodes[kind] += result.nodes;
+					stats.optEdges[kind] += result.edges;
+					Print("%s: %u nodes, %u edges removed\n", graph_pipeline::PassName(kind), result.nodes, result.edges);
+				}
+				nodeID = ids.node;
+				edgeID = ids.edge;
+			}
 
-								dependents.push_back(&*ins);	//add instruction to dependents list
-								if (depIter != dependents.end()) continue;
-								assert (dominated != succ_end(bbl));	//add control dependence edge, check which successor is in question
+			void Schedule(unsigned int recMII) {	//modulo schedule of the final graph
+				scheduler->Schedule(graph, recMII, 0, schedule);
+				stats.resMII = schedule.resMII;
+				stats.scheduleRecMII = schedule.recMII;
+				stats.ii = schedule.ii;
+				stats.stages = schedule.stages;
+				stats.timedOut = schedule.timedOut;
+				if (schedule.ii) Print("II = %u (ResMII %u, RecMII %u), %u stages, %u cycles\n", schedule.ii, schedule.resMII,
+						schedule.recMII, schedule.stages, schedule.length);
+				else Report("loop %u: no modulo schedule%s\n", task.id, schedule.timedOut ? " within -dfg-schedule-budget" : "");
+			}
 
-								clust_dep edgTyp = CTRLDEP_0;
-								if (dominated == succ_begin(bbl)) { edgTyp = CTRLDEP_0; }
-								else { edgTyp = CTRLDEP_1; }
-								map <Value*, clust_node>::iterator srcNode = loopGraph->second.find(&*ins);
-								assert (srcNode != loopGraph->second.end());
+			void Map(unsigned int recMII) {	//placement and routing of the final graph
+				mapper->Map(graph, recMII, mapping);
+				stats.mapResMII = mapping.resMII;
+				stats.mapRecMII = mapping.recMII;
+				stats.mapII = mapping.ii;
+				stats.fuUse = mapping.fuUse;
+				stats.linkUse = mapping.linkUse;
+				stats.registerUse = mapping.registerUse;
+				stats.mapTimedOut = mapping.timedOut;
+				if (mapping.ii) Print("mapped at II = %u (ResMII %u, RecMII %u), FU %.0f%%, links %.0f%%, registers %.0f%%%s\n", mapping.ii,
+						mapping.resMII, mapping.recMII, 100 * mapping.fuUse, 100 * mapping.linkUse, 100 * mapping.registerUse,
+						mapping.timedOut ? ", lower IIs cut short by -dfg-map-budget" : "");
+				else if (mapping.timedOut) Report("loop %u: no CGRA mapping within -dfg-map-budget\n", task.id);
+				else if (!mapping.error.empty()) Report("loop %u: no CGRA mapping, %s\n", task.id, mapping.error.c_str());
+			}
 
-								edgeID ++;	//create a new edge
+			unsigned int Immediates() const {	//live nodes with a folded constant or a GEP immediate
+				unsigned int immediates = 0;
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++)
+					if (!graph.Node(n).removed && (graph.Node(n).imm || graph.Node(n).gepImm)) immediates ++;
+				return immediates;
+			}
 
-								clust_edge newEdge;
-								newEdge.target = &(srcNode->second);
-								newEdge.depType = edgTyp;
-								newEdge.backEdge = false;
-								newEdge.id = edgeID;
+			struct gep_expansion {
+				unsigned int result;	//node giving the address; the base producer for a GEP that adds nothing
+				unsigned int baseEdge;	//edge from the base producer of a GEP that adds nothing, ~0U otherwise
+				unsigned int ctrlFirst;	//its control in-edges are gepEdges[ctrlFirst, ctrlLast)
+				unsigned int ctrlLast;
+			};
+
+			// Every GEP becomes a chain of adds from its base, one per variable index, each
+			// index scaled by a GEP_SHL (power of two) or a GEP_MULT node unless its scale
+			// is 1; the constant indices and struct fields are the immediate of a last add.
+			// A GEP that adds nothing is replaced by its base. The new edges are collected
+			// while the GEPs are still in the graph and added once they are detached.
+			void RemoveGEP(unsigned int id) {
+				const unsigned int noNode = ~0U;
+				vector <gep_expansion> expansions;
+				vector <unsigned int> expansionOf(graph.NumNodes(), noNode);	//expanded GEP node -> its expansion
+				for (unsigned int g = 0; g < task.geps.size(); g ++) expansionOf[insNode[task.geps[g].pos]] = g;
+				expansions.resize(task.geps.size());
+
+				vector <unsigned int> gepEdges;	//control in-edges of GEPs that add nothing
+				vector <clust_edge> newEdges;	//src may still be a GEP node, see below
+				vector <unsigned int> folded;	//producers of constant indices
+				vector <unsigned int> operandDst;	//node taking each operand of the GEP, noNode if folded
+				for (unsigned int g = 0; g < task.geps.size(); g ++) {	//create the expansion nodes and record the edges
+					const loop_gep& gep = task.geps[g];
+					unsigned int node = insNode[gep.pos];
+					GetElementPtrInst* ins = cast<GetElementPtrInst>(graph.Node(node).ins);
+					double gepWt = graph.Node(node).wt;
+					gep_expansion& exp = expansions[g];
+					exp.baseEdge = noNode;
+					exp.ctrlFirst = exp.ctrlLast = gepEdges.size();
+
+					unsigned int nAdds = gep.nIndices + (gep.offset != 0);
+					if (!nAdds && UsedOutside(ins)) nAdds = 1;	//keep a node for the value used after the loop
+					operandDst.assign(ins->getNumOperands(), noNode);
+					unsigned int first = noNode, last = noNode;	//adds of the chain
+					for (unsigned int i = 0; i < gep.nIndices; i ++) {
+						const loop_gep_index& index = task.gepIndices[gep.firstIndex + i];
+						unsigned int add = AddGEPNode(graph, node, (i + 1 < nAdds) ? GEP_ADD2 : GEP_ADD1);
+						unsigned int scaled = add;	//node the index goes into
+						if (index.scale != 1) {
+							scaled = AddGEPNode(graph, node, isPowerOf2_64(index.scale) ? GEP_SHL : GEP_MULT);
+							graph.Node(scaled).gepImm = isPowerOf2_64(index.scale) ? Log2_64(index.scale) : index.scale;
+							newEdges.push_back(GEPEdge(scaled, add, gepWt));
+						}
+						operandDst[index.operand] = scaled;
+						if (last != noNode) newEdges.push_back(GEPEdge(last, add, gepWt));
+						else first = add;
+						last = add;
+					}
+					if (gep.nIndices < nAdds) {	//the constant part
+						unsigned int add = AddGEPNode(graph, node, GEP_ADD1);
+						graph.Node(add).gepImm = gep.offset;
+						if (last != noNode) newEdges.push_back(GEPEdge(last, add, gepWt));
+						else first = add;
+						last = add;
+					}
+					exp.result = last;
+					operandDst[ins->getPointerOperandIndex()] = first;
+
+					vector<bool> taken(ins->getNumOperands(), false);	//operand occurrences matched to data edges
+					for (unsigned int k = graph.InBegin(node); k != graph.InEnd(node); k ++) {
+						unsigned int e = graph.InEdge(k);
+						const clust_edge& edge = graph.Edge(e);
+						if (edge.removed) continue;
+						if (edge.depType != DATADEP) {	//control dependences hold for the whole chain through its first add
+							if (first == noNode) gepEdges.push_back(e);
+							else {
+								newEdges.push_back(edge);
+								newEdges.back().dst = first;
+							}
+							continue;
+						}
+						unsigned int o = 0;
+						while (o < ins->getNumOperands() && (taken[o] || ins->getOperand(o) != graph.Node(edge.src).ins)) o ++;
+						assert (o < ins->getNumOperands());
+						taken[o] = true;
+						if (operandDst[o] == noNode) {
+							if (o == ins->getPointerOperandIndex()) exp.baseEdge = e;	//the base stands in for the GEP
+							else folded.push_back(edge.src);
+							continue;
+						}
+						newEdges.push_back(edge);
+						newEdges.back().dst = operandDst[o];
+					}
+					exp.ctrlLast = gepEdges.size();
+					if (first == noNode) {
+						assert (exp.baseEdge != noNode);
+						exp.result = graph.Edge(exp.baseEdge).src;
+					}
 
-								dstNode->second.edges.push_back(newEdge);
+					for (unsigned int k = graph.OutBegin(node); k != graph.OutEnd(node); k ++) {
+						const clust_edge& edge = graph.Edge(graph.OutEdge(k));
+						if (edge.removed || expansionOf[edge.dst] != noNode) continue;	//a GEP consumer takes the edge among its in-edges
+						newEdges.push_back(edge);	//from the GEP node, resolved below
+					}
+				}
 
+				for (unsigned int g = 0; g < task.geps.size(); g ++) graph.RemoveNode(insNode[task.geps[g].pos]);	//detach the GEPs
+				for (unsigned int f = 0; f < folded.size(); f ++) {	//and constant indices used by nothing else
+					unsigned int n = folded[f];
+					if (graph.Node(n).nodeType == DATANODE && !graph.OutDegree(n)) graph.RemoveNode(n);
+				}
 
-								clust_edge outEdge;
-								outEdge.target = &(dstNode->second);
-								outEdge.depType = edgTyp;
-								outEdge.wt = newEdge.wt;
-								outEdge.id = edgeID;
-								outEdge.backEdge = false;
-								srcNode->second.outgoingEdges.push_back(outEdge);
+				for (unsigned int e = 0; e < newEdges.size(); e ++) {
+					clust_edge edge = newEdges[e];
+					while (edge.src < expansionOf.size() && expansionOf[edge.src] != noNode) {	//from a GEP node: from its result
+						const gep_expansion& exp = expansions[expansionOf[edge.src]];
+						if (exp.baseEdge != noNode) {	//through a GEP that adds nothing, which may have been control dependent
+							const clust_edge& base = graph.Edge(exp.baseEdge);
+							edge.distance += base.distance;
+							edge.unknownDistance = edge.unknownDistance || base.unknownDistance;
+							edge.backEdge = edge.backEdge || base.backEdge;
+							for (unsigned int c = exp.ctrlFirst; c < exp.ctrlLast; c ++) {
+								const clust_edge& ctrl = graph.Edge(gepEdges[c]);
+								if (!graph.HasEdge(ctrl.src, edge.dst)) AddGEPEdge(ctrl.src, edge.dst, ctrl);
+							}
+						}
+						edge.src = exp.result;
+					}
+					AddGEPEdge(edge.src, edge.dst, edge);
+				}
 
-							}//create a control dep edge from each ins in inner block to terminal ins of outer block
-						}//control dependence exists
-					}//check whether inner block is control dependent on outer block
-				}//for each block
-			}//AddCtrlEdges
+				stats.gepsExpanded = task.geps.size();
+				graph.Finalize();
+			} // end function
 
-			void PrintDotGraph(list<clust_node> *gepNodes, unsigned int id) {
-				map <unsigned int, clust_graph>::iterator loopGraph = graphs.find(id);		//get loop graph
-				assert (loopGraph != graphs.end());
+			static clust_edge GEPEdge(unsigned int src, unsigned int dst, double wt) {	//within the expansion of a GEP
+				clust_edge edge;
+				edge.src = src;
+				edge.dst = dst;
+				edge.depType = DATADEP;
+				edge.wt = wt;
+				edge.distance = 0;
+				edge.unknownDistance = false;
+				edge.backEdge = false;
+				return edge;
+			}
 
+			void AddGEPEdge(unsigned int src, unsigned int dst, const clust_edge& like) {	//with the dependence and distance of like
+				unsigned int e = graph.AddEdge(src, dst, like.depType, like.wt, ++edgeID);
+				graph.Edge(e).distance = like.distance;
+				graph.Edge(e).unknownDistance = like.unknownDistance;
+				graph.Edge(e).backEdge = like.backEdge;
+			}
 
-				char fileName[256];	//create file name
-				sprintf(fileName, "%u.loop_analysis_graph.dot", id);
+			bool UsedOutside(Instruction* ins) const {	//after the loop
+				for (Value::use_iterator use = ins->use_begin(), ue = ins->use_end(); use != ue; ++use) {
+					Instruction* user = dyn_cast<Instruction>(*use);
+					if (!user || graph.Find(user) < 0) return true;
+				}
+				return false;
+			}
 
-				FILE* lf = fopen(fileName, "w");	//open file
-				fprintf(lf, "digraph loop_analysis_graph {\n");
 
 
-				for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++) {
-					if(nodeIter->second.nodeType == INSTNODE) {
-						Instruction *inst = (Instruction *)(nodeIter->first);
-						int opcode = inst->getOpcode();
-						const char *I = inst->getOpcodeName(opcode);
+			static void ResetSearch (clust_graph& graph) {	//clear the marks of the depth-first search of FindRecurrences
 
-						if(!nodeIter->second.isLoad) {
-							if (nodeIter->second.type == 'N') 	//compute node
-								fprintf(lf, "%u [label=\"\t%u %s\", shape=oval]\n", nodeIter->second.id,nodeIter->second.id, I );
-							else if (nodeIter->second.type == 'F')
-								fprintf(lf, "%u [label=\"%u %s\", shape=doublecircle]\n", nodeIter->second.id, nodeIter->second.id, I);
-							else fprintf(lf, "%u [label=\"%u %s\", shape=triplecircle]\n", nodeIter->second.id,nodeIter->second.id, I );
-						} else {
-							if (nodeIter->second.type == 'N') 	//memory node
-								fprintf(lf, "%u [ label=\"%u %s\", shape=octagon]\n", nodeIter->second.id,nodeIter->second.id,I);
-							else if (nodeIter->second.type == 'F')
-								fprintf(lf, "%u [label=\"%u %s\", shape=doubleoctagon]\n", nodeIter->second.id, nodeIter->second.id,I);
-							else fprintf(lf, "%u [label=\"%u %s\", shape=tripleoctagon]\n", nodeIter->second.id, nodeIter->second.id, I);
-						}
-					}
-					else if (nodeIter->second.nodeType == DATANODE) {
-						fprintf(lf, "%u [shape=box,color=blue,label=\"%u  \"]\n", nodeIter->second.id, nodeIter->second.id);
-					}
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++) { //initialize
 
-					for (list<clust_edge>::iterator edgIter = nodeIter->second.edges.begin();
-							edgIter != nodeIter->second.edges.end(); edgIter ++) {	//for each edge
-						if (edgIter->backEdge) continue;
-						if (edgIter->depType == DATADEP) {
-							fprintf(lf, "%u -> %u [label=\"\"]\n", nodeIter->second.id, edgIter->target->id);}
-						else if (edgIter->depType == CTRLDEP_0)
-							fprintf(lf, "%u -> %u [style=dashed,color=red,label=\"\"]\n",  nodeIter->second.id,
-									edgIter->target->id);
-						else fprintf(lf, "%u -> %u [style=dashed,color=blue,label=\"\"]\n",  nodeIter->second.id,
-								edgIter->target->id);
-					}
+					graph.Node(n).visited = false;
+					graph.Node(n).nBackEdgesIn = 0;
+					graph.Node(n).nBackEdgesOut = 0;
+				}
+			}
+
+			void RemoveCycle (clust_graph& graph) {	//mark the loop-carried edges so that the graph becomes acyclic, find the recurrences
+				ResetSearch(graph);
+				stats.backEdges = graph.FindRecurrences();	//DFS roots in program order
+				stats.recMII = graph.RecMII();
+			}//RemoveCycle
+	};
+
+	class BuildJob : public pool_job {	//builds the collected loops on the pool
+		public:
+			explicit BuildJob(deque<loop_task>& loopTasks) : tasks(loopTasks) {}
+			virtual void Run(unsigned int t) {
+				{
+					LoopGraphBuilder builder(tasks[t]);
+					builder.Run();
 				}
+				loop_task done;	//release the snapshot as well, the other tasks stay where they are
+				tasks[t].blocks.swap(done.blocks);
+				tasks[t].ctrlDeps.swap(done.ctrlDeps);
+				tasks[t].memDeps.swap(done.memDeps);
+				tasks[t].accesses.swap(done.accesses);
+				tasks[t].elided.swap(done.elided);
+				tasks[t].geps.swap(done.geps);
+				tasks[t].gepIndices.swap(done.gepIndices);
+				tasks[t].blockWt.swap(done.blockWt);
+			}
+		private:
+			deque<loop_task>& tasks;
+	};
 
+	// The function analyses that weigh the loops. LoopGraphAnalysisPass_0 requests
+	// this pass once for every function with loops, to weigh the module and select
+	// the loops; the on the fly pass manager then runs each analysis once for the
+	// function, and the results stay valid until the next request.
+	class LoopGraphFunctionAnalyses : public FunctionPass {
 
-				//-- print the replaced GEP instructions as well
-				if(gepNodes->size() != 0) {
-					for(list<clust_node>::iterator listIter = gepNodes->begin(); listIter != gepNodes->end(); listIter++) {
+		public:
 
-						const char *nodeText;
-						switch(listIter->gepNodeType) {
-							case GEP_ADD1: nodeText = "GEP_ADD1\0"; break;
-							case GEP_ADD2: nodeText = "GEP_ADD2\0"; break;
-							case GEP_MULT: nodeText = "GEP_MULT\0"; break;
-							case GEP_SIZE: nodeText = "GEP_SIZE\0"; break;
-						}
-						fprintf(lf, "%u [label=\"\t%u %s\", style=filled, fillcolor=lightgrey, shape=oval]\n", listIter->id, listIter->id, nodeText);
-
-						for(list<clust_edge>::iterator edgIter = listIter->outgoingEdges.begin();
-								edgIter != listIter->outgoingEdges.end(); edgIter++) {	//for each edge
-							if (edgIter->backEdge) continue;
-							if (edgIter->depType == DATADEP)
-								fprintf(lf, "%u -> %u [label=\"\"]\n",  edgIter->gepTargetID, listIter->id);
-							else if (edgIter->depType == CTRLDEP_0)
-								fprintf(lf, "%u -> %u [style=dashed,color=red,label=\"\"]\n",  edgIter->gepTargetID, listIter->id);
-							else fprintf(lf, "%u -> %u [style=dashed,color=blue,label=\"\"]\n",  edgIter->gepTargetID, listIter->id);
-						}
+			static char ID;
+			LoopInfo* LI;
+			BlockFrequencyInfo* BFI;
 
-						for(list<clust_edge>::iterator edgIter = listIter->edges.begin(); edgIter != listIter->edges.end(); edgIter++) { //for each edge
-							if (edgIter->backEdge) continue;
-							if (edgIter->depType == DATADEP)
-								fprintf(lf, "%u -> %u [label=\"\"]\n", listIter->id, edgIter->gepTargetID);
-							else if (edgIter->depType == CTRLDEP_0)
-								fprintf(lf, "%u -> %u [style=dashed,color=red,label=\"\"]\n",  listIter->id, edgIter->gepTargetID);
-							else fprintf(lf, "%u -> %u [style=dashed,color=blue,label=\"\"]\n",  listIter->id, edgIter->gepTargetID);
-						}
-					}
+			explicit LoopGraphFunctionAnalyses() : FunctionPass(ID), LI(0), BFI(0) {}
+
+			void getAnalysisUsage(AnalysisUsage &AU) const {
+				AU.setPreservesAll();
+				AU.addRequired<LoopInfo>();
+				AU.addRequired<BlockFrequencyInfo>();	//node weights, from the profile if one was applied
+			}
+
+			virtual bool runOnFunction(Function& F) {
+				LI = &getAnalysis<LoopInfo>();
+				BFI = &getAnalysis<BlockFrequencyInfo>();
+				return false;
+			}
+	};
+
+	// The function analyses that collect the selected loops, those above and the
+	// ones for memory dependences and affine addresses. It is only requested for
+	// the functions with selected loops, once the module has been weighed. An
+	// analysis only needed by an optional feature is only required when that
+	// feature is enabled.
+	class LoopGraphMemoryAnalyses : public FunctionPass {
+
+		public:
+
+			static char ID;
+			LoopInfo* LI;
+			BlockFrequencyInfo* BFI;
+			AliasAnalysis* AA;	//with -dfg-mem-deps
+			DependenceAnalysis* DA;
+			ScalarEvolution* SE;	//with -dfg-affine
+
+			explicit LoopGraphMemoryAnalyses() : FunctionPass(ID), LI(0), BFI(0), AA(0), DA(0), SE(0) {}
+
+			void getAnalysisUsage(AnalysisUsage &AU) const {
+				AU.setPreservesAll();
+				AU.addRequired<LoopGraphFunctionAnalyses>();
+				if (DFGMemDeps) {	//memory dependence edges
+					AU.addRequired<AliasAnalysis>();
+					AU.addRequired<DependenceAnalysis>();
 				}
-				fprintf(lf, "}\n");
-				fclose(lf);
+				if (DFGAffine) AU.addRequired<ScalarEvolution>();	//affine addresses
 			}
 
+			virtual bool runOnFunction(Function& F) {
+				LoopGraphFunctionAnalyses& weights = getAnalysis<LoopGraphFunctionAnalyses>();
+				LI = weights.LI;
+				BFI = weights.BFI;
+				if (DFGMemDeps) {
+					AA = &getAnalysis<AliasAnalysis>();
+					DA = &getAnalysis<DependenceAnalysis>();
+				}
+				if (DFGAffine) SE = &getAnalysis<ScalarEvolution>();
+				return false;
+			}
+	};
 
-			void RemoveGEP(list<clust_node> *gepNodes, unsigned int id) {
+	class LoopGraphAnalysisPass_0 : public ModulePass {
 
-				map <unsigned int, clust_graph>::iterator loopGraph = graphs.find(id);
-				assert(loopGraph != graphs.end());
+		public:
 
-				for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++)
-				{
-					Value* ins = nodeIter->second.ins;
-
-					if(isa<GEPOperator>(*&ins)) {
-
-						clust_node newAddNode;
-						newAddNode.ins = ins;
-						newAddNode.isLoad = false;
-						newAddNode.id = ++nodeID;
-						newAddNode.entryNode = false;
-						newAddNode.wt = wt;
-						newAddNode.nodeType = INSTNODE;
-						newAddNode.depth = 0;
-						newAddNode.gepNodeType = GEP_ADD1;
-
-						clust_node newAdd2Node;
-						newAdd2Node.ins = nodeIter->second.ins;
-						newAdd2Node.id = ++nodeID ;
-						newAdd2Node.entryNode = false;
-						newAdd2Node.wt = wt;
-						newAdd2Node.nodeType = INSTNODE;
-						newAdd2Node.depth = 0;
-						newAdd2Node.gepNodeType = GEP_ADD2;
-
-						clust_node newMultNode;
-						newMultNode.ins = nodeIter->second.ins;
-						newMultNode.id = ++nodeID ;
-						newMultNode.entryNode = false;
-						newMultNode.wt = wt;
-						newMultNode.nodeType = INSTNODE;
-						newMultNode.gepNodeType = GEP_MULT;
-						newMultNode.depth = 0;
-
-
-						// connect edge between add2 to add1
-						clust_edge newEdge1;
-						newEdge1.gepTargetID = newAdd2Node.id;
-						newEdge1.depType = DATADEP;
-						newEdge1.id = ++edgeID;
-						newEdge1.backEdge = false;
-						newAddNode.outgoingEdges.push_back(newEdge1);
-
-						// connect mul to add2
-						clust_edge newEdgeMulAdd2;
-						newEdgeMulAdd2.gepTargetID = newMultNode.id;
-						newEdgeMulAdd2.depType = DATADEP;
-						newEdgeMulAdd2.id = ++edgeID;
-						newEdgeMulAdd2.backEdge = false;
-						newAdd2Node.outgoingEdges.push_back(newEdgeMulAdd2);
-
-						clust_node newSizeNode;
-						newSizeNode.ins = nodeIter->second.ins;
-						newSizeNode.id = ++nodeID ;
-						newSizeNode.entryNode = false;
-						newSizeNode.wt = wt;
-						newSizeNode.nodeType = INSTNODE;
-						newSizeNode.depth = 0;
-						newSizeNode.gepNodeType = GEP_SIZE;
-
-						//-- connect size to mul
-						clust_edge newEdgeSizeMul;
-						newEdgeSizeMul.gepTargetID = newSizeNode.id;
-						newEdgeSizeMul.depType = DATADEP;
-						newEdgeSizeMul.id = ++edgeID;
-						newEdgeSizeMul.backEdge = false;
-						newMultNode.outgoingEdges.push_back(newEdgeSizeMul);
-
-						//-- connect add1 to the original child node of the GEP
-						for(list<clust_edge>::iterator edgIter = nodeIter->second.edges.begin();
-								edgIter != nodeIter->second.edges.end(); edgIter++) {
-							clust_edge newEdgeAddGEPEnd;
-							newEdgeAddGEPEnd.gepTargetID = edgIter->target->id;
-							newEdgeAddGEPEnd.depType = edgIter->depType;
-							newEdgeAddGEPEnd.id = ++edgeID;
-							newEdgeAddGEPEnd.backEdge = edgIter->backEdge;
-							newAddNode.edges.push_back(newEdgeAddGEPEnd);
+			static char ID; 		// Class identification, replacement for typeinfo.
+			LoopInfo* LI;
+			BlockFrequencyInfo* BFI;
+			AliasAnalysis* AA;	//with -dfg-mem-deps
+			DependenceAnalysis* DA;
+			ScalarEvolution* SE;	//with -dfg-affine
+			DataLayout* DL;	//sizes and struct layouts for GEP expansion, of the module
+			double totWt;	//dynamic instructions of the module, see runOnModule
 
-						}
 
-						//-- connect the incoming edges of the original GEP
-						GEPOperator *instr = dyn_cast<GEPOperator>(*&ins);
-						for(list<clust_edge>::iterator edgIter = nodeIter->second.outgoingEdges.begin();
-								edgIter != nodeIter->second.outgoingEdges.end(); edgIter++) {
-							clust_edge newEdgeGEP;
-							newEdgeGEP.gepTargetID = edgIter->target->id;
-							newEdgeGEP.depType = edgIter->depType;
-							newEdgeGEP.id = ++edgeID;
-							newEdgeGEP.backEdge = edgIter->backEdge;
+			explicit LoopGraphAnalysisPass_0() : ModulePass(ID), AA(0), DA(0), SE(0), DL(0), totWt(0), funcSelected(true), funcFilter(0), locFilter(0),
+				postDom(true), ctrlDepFunc(0), nextCandidate(0) {}
 
 
-							if(edgIter->target->ins == instr->getOperand(0)) {
-								newAddNode.outgoingEdges.push_back(newEdgeGEP);
-							} else if(edgIter->target->ins == instr->getOperand(1)) {
-								newAdd2Node.outgoingEdges.push_back(newEdgeGEP);
-							} else {
-								newMultNode.outgoingEdges.push_back(newEdgeGEP);
+			// Function analyses are computed on the fly, only for the functions that have
+			// loops, see runOnModule. Every getAnalysis<>(F) reruns all of the required
+			// function analyses for F, so each sweep takes them from one request.
+			void getAnalysisUsage(AnalysisUsage &AU) const {
+				AU.setPreservesAll();
+				AU.addRequired<LoopGraphFunctionAnalyses>();
+				AU.addRequired<LoopGraphMemoryAnalyses>();
+			}
 
-							}
-						}
+			virtual bool doInitialization(Module& M) {	//doInitialization
+				useTimers = DFGTime && !Deferred();
+				if (DFGTime && Deferred())
+					fprintf(stderr, "warning: -dfg-time needs -dfg-threads=1, use -dfg-report for the phase times\n");
+				for (unsigned int p = 0; useTimers && p < NUM_PHASES; p ++)
+					if (!phaseTimers[p].isInitialized()) phaseTimers[p].init(phaseNames[p], phaseTimerGroup);
+				if (DFGCompress && !CompressionAvailable())
+					fprintf(stderr, "warning: LLVM was built without zlib, -dfg-compress is ignored\n");
+				if (!DFGFunction.empty()) funcFilter = CompileFilter(DFGFunction, "-dfg-function");
+				if (!DFGLocation.empty()) locFilter = CompileFilter(DFGLocation, "-dfg-location");
+				if (!DFGLatency.empty()) {
+					string error;
+					if (!latencyModel.Load(DFGLatency, error)) report_fatal_error(Twine("-dfg-latency: ") + error);
+				}
+				const vector<latency_entry>& table = latencyModel.Table();
+				latencyFingerprint = HashBytes(&table[0], table.size() * sizeof(latency_entry));
+				if (!optPipeline.NumPasses())
+					for (unsigned int p = 0; p < DFGOpt.size(); p ++) optPipeline.Add(DFGOpt[p]);
+				DL = new DataLayout(&M);
+				if (DFGSchedule && !scheduler) scheduler = new modulo_scheduler(ScheduleConfig());
+				if ((DFGMap || !DFGCGRA.empty()) && !mapper) {
+					cgra_grid grid;
+					string error;
+					if (!DFGCGRA.empty() && !grid.Load(DFGCGRA, error)) report_fatal_error(Twine("-dfg-cgra: ") + error);
+					map_config config;
+					config.restarts = max(DFGMapRestarts.getValue(), 1U);
+					config.threads = Deferred() ? 1 : HardwareThreads();	//the loops have the pool already
+					config.budget = DFGMapBudget / 1000.0;
+					mapper = new cgra_mapper(grid, config);
+				}
+				if (!DFGCache.empty()) {
+					graphCache = new loop_cache(DFGCache);
+					if (!graphCache->Usable()) {
+						fprintf(stderr, "warning: cannot use %s as the loop graph cache, -dfg-cache is ignored\n", DFGCache.c_str());
+						delete graphCache;
+						graphCache = 0;
+					}
+				}
+				return false;
+			}
 
+			virtual bool doFinalization(Module& M) {	//reports over all the loops
+				if (DFGMemReport) PrintMemReport();
+				if (!DFGReport.empty()) WriteReport();
+				if (graphCache) fprintf(stderr, "loop graph cache: %u hits, %u misses\n", cacheHits, cacheMisses);
+				delete graphCache;
+				graphCache = 0;
+				delete DL;
+				DL = 0;
+				delete scheduler;
+				scheduler = 0;
+				delete mapper;
+				mapper = 0;
+				delete funcFilter;
+				delete locFilter;
+				funcFilter = locFilter = 0;
+				return false;
+			}
 
-						gepNodes->push_back(newAddNode);
-						gepNodes->push_back(newAdd2Node);
-						gepNodes->push_back(newMultNode);
-						gepNodes->push_back(newSizeNode);
 
-						// deleting the incoming edges of GEP node
-						for(list<clust_edge> :: iterator itr = nodeIter->second.outgoingEdges.begin();
-								itr != nodeIter->second.outgoingEdges.end(); itr++) {
-							for(list<clust_edge>:: iterator parIter = itr->target->edges.begin();
-									parIter != itr->target->edges.end(); parIter++) {
-								if(parIter->target->id == nodeIter->second.id)
-									parIter = itr->target->edges.erase(parIter);
-							}
-						}
+			// Weights are executions per call of the function, from the block frequencies;
+			// with no profile applied they are the static estimates of BranchProbabilityInfo.
+			// The coverage of a loop is its share of the dynamic instructions of the module,
+			// counting one call of every function. A first sweep weighs the module and the
+			// innermost loops the filters select, then the hot loops are chosen. The second
+			// sweep collects only those; on one thread each is built as soon as it has been
+			// collected, so only one loop is alive at a time, while several threads get the
+			// loops of the whole module at once.
+			virtual bool runOnModule(Module& M) {
+				totWt = 0;
+				for (Module::iterator fi = M.begin(), fe = M.end(); fi != fe; ++fi) {	//weigh
+					Function& F = *fi;
+					if (F.isDeclaration()) continue;
+					if (!HasCycle(F)) {	//loop-free functions need no analysis at all, every block runs at most once
+						for (Function::iterator bi = F.begin(), be = F.end(); bi != be; ++bi) totWt += bi->size();
+						continue;
+					}
 
-						//deleting the outgoing edges of GEP node
-						for(list<clust_edge> :: iterator itr = nodeIter->second.edges.begin();
-								itr != nodeIter->second.edges.end(); itr++) {
-							for(list<clust_edge>:: iterator parIter = itr->target->outgoingEdges.begin();
-									parIter != itr->target->outgoingEdges.end(); parIter++) {
-								if(parIter->target->id == nodeIter->second.id)
-									parIter = itr->target->outgoingEdges.erase(parIter);
-							}
-						}
+					LoopGraphFunctionAnalyses& weights = getAnalysis<LoopGraphFunctionAnalyses>(F);	//runs each analysis once for F
+					LI = weights.LI;
+					BFI = weights.BFI;
+					for (Function::iterator bi = F.begin(), be = F.end(); bi != be; ++bi) totWt += BlockWeight(&*bi) * bi->size();
+
+					loop_func func;
+					func.F = &F;
+					func.firstLoop = loopID;
+					func.firstCandidate = candidates.size();
+					loopFuncs.push_back(func);
+					funcSelected = !funcFilter || funcFilter->match(F.getName());
+					for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I)	//gives the collection of Loops
+						WeighLoop(*I);
+				}
 
-						for(list<clust_edge>::iterator Iter=nodeIter->second.outgoingEdges.begin();
-								Iter != nodeIter->second.outgoingEdges.end(); Iter++) {
-							Iter = nodeIter->second.outgoingEdges.erase(Iter);
-						}
+				for (unsigned int c = 0; c < candidates.size(); c ++)	//coverage now that the module total is known
+					candidates[c].cov = (totWt > 0) ? candidates[c].wt / totWt : 0;
+				SelectHotLoops();
+
+				nextCandidate = 0;
+				for (unsigned int f = 0; f < loopFuncs.size(); f ++) {	//collect and build
+					unsigned int end = (f + 1 < loopFuncs.size()) ? loopFuncs[f + 1].firstCandidate : candidates.size();
+					bool hot = false;
+					for (unsigned int c = loopFuncs[f].firstCandidate; c < end; c ++) hot = hot || candidates[c].selected;
+					if (!hot) {
+						nextCandidate = end;
+						continue;
+					}
 
-						for(list<clust_edge>::iterator edgIter=nodeIter->second.edges.begin(); edgIter != nodeIter->second.edges.end(); edgIter++) {
-							edgIter = nodeIter->second.edges.erase(edgIter);
-						}
+					Function& F = *loopFuncs[f].F;
+					LoopGraphMemoryAnalyses& analyses = getAnalysis<LoopGraphMemoryAnalyses>(F);	//valid until the next request
+					LI = analyses.LI;
+					BFI = analyses.BFI;
+					AA = analyses.AA;
+					DA = analyses.DA;
+					SE = analyses.SE;
+					loopID = loopFuncs[f].firstLoop;
+					ctrlDepFunc = 0;	//control dependences are computed on demand for this function
+					for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I)
+						ProcessLoop(*I);
+				}
+				postDom.releaseMemory();
+				loopFuncs.clear();
+				candidates.clear();
 
-					} // if GEP node
+				if (Deferred()) {	//on one thread ProcessLoop has built them already
+					BuildJob job(tasks);
+					RunWorkStealing(job, tasks.size(), NumThreads());
+				}
+				tasks.clear();
+				return false;
+			}
 
 
-					//	Deleting the GEP node
+			bool ProcessLoop(Loop* L) {
+				for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I) {
+					ProcessLoop(*I);
+				}
 
-					if(isa<GEPOperator>(*&ins) && (nodeIter->second.nodeType == INSTNODE)) {
-						map<Value*, clust_node>::iterator eraseItr = nodeIter;
-						++nodeIter;
-						loopGraph->second.erase(eraseItr);
+				bool candidate = L->getSubLoops().empty() && nextCandidate < candidates.size() && candidates[nextCandidate].id == loopID;
+				if (candidate && candidates[nextCandidate].selected) {
+					tasks.push_back(loop_task());	//take everything the builder needs from the analyses
+					loop_task& task = tasks.back();
+					task.id = loopID;
+					task.blocks = L->getBlocks();
+					task.cov = candidates[nextCandidate].cov;
+					task.blockWt.resize(task.blocks.size());
+					for (unsigned int b = 0; b < task.blocks.size(); b ++) task.blockWt[b] = BlockWeight(task.blocks[b]);
+
+					DenseMap <BasicBlock*, unsigned int> loopPos;	//position of each block in the loop
+					for (unsigned int b = 0; b < task.blocks.size(); b ++) loopPos[task.blocks[b]] = b;
+					CollectCtrlDeps(L, loopPos, task);
+					task.memOps = 0;
+					if (DFGMemDeps) CollectMemDeps(L, loopPos, task);
+					if (DFGAffine) CollectAffineAccesses(L, task);
+					CollectGEPs(task);
+
+					if (!Deferred()) {	//build it right away
+						BuildJob job(tasks);
+						job.Run(0);
+						tasks.clear();
 					}
-				} // end for node iterator
-			} // end function
+				}
+				if (candidate) nextCandidate ++;
 
+				loopID ++;
 
+				return false;
+			}
 
-			void RemoveCycle (list<clust_node*>& nodeStack) {
+		private:
 
-				if (nodeStack.empty()) return;
-				clust_node* topNode = nodeStack.back();
+			DominatorTreeBase<BasicBlock> postDom;	//post-dominator tree, built only for functions with loops
+
+			typedef DenseMap<BasicBlock*, vector<ctrl_dep> > ctrl_dep_map;
+			ctrl_dep_map ctrlDeps;	//branch block -> blocks control dependent on it
+			Function* ctrlDepFunc;	//function ctrlDeps was computed for
+
+			deque <loop_task> tasks;	//innermost loops waiting to be built
+
+			typedef struct
+			{
+				unsigned int id;
+				double wt;	//dynamic instructions of the loop per call of its function
+				double cov;
+				bool selected;	//passes the coverage threshold and top N as well
+			}loop_candidate;
+			vector<loop_candidate> candidates;	//innermost loops the filters select, in loop order
+			unsigned int nextCandidate;	//the next one ProcessLoop will meet
+
+			typedef struct
+			{
+				Function* F;
+				unsigned int firstLoop;	//id of its first loop
+				unsigned int firstCandidate;	//its candidates start here
+			}loop_func;
+			vector<loop_func> loopFuncs;	//functions with loops, in module order
+
+			bool funcSelected;	//the current function passes -dfg-function
+			Regex* funcFilter;
+			Regex* locFilter;
+
+			static schedule_config ScheduleConfig() {	//the units of -dfg-units over the defaults, the budget in seconds
+				schedule_config config;
+				config.units[FU_NONE] = 0;
+				config.units[FU_ALU] = 4;
+				config.units[FU_MUL] = 2;
+				config.units[FU_MEM] = 2;
+				config.units[FU_FP] = 2;
+				config.transfer = 0;	//values go between units for free
+				config.budget = DFGScheduleBudget / 1000.0;
+				for (unsigned int u = 0; u < DFGUnits.size(); u ++) {
+					const string& unit = DFGUnits[u];
+					size_t eq = unit.find('=');
+					unsigned int fu = 0;
+					while (fu < NUM_FU_CLASSES && unit.compare(0, eq, latency_model::FUName(fu)) != 0) fu ++;
+					char* end = 0;
+					unsigned long count = (eq == string::npos) ? 0 : strtoul(unit.c_str() + eq + 1, &end, 10);
+					if (fu == FU_NONE || fu == NUM_FU_CLASSES || eq == string::npos || end == unit.c_str() + eq + 1 || *end || !count)
+						report_fatal_error(Twine("-dfg-units: ") + unit + " is not CLASS=n with n >= 1 units of ALU, MUL, MEM or FP");
+					config.units[fu] = count;
+				}
+				return config;
+			}
 
-				for (list<clust_edge>::iterator edgIter = topNode->edges.begin(); 	//process children
-						edgIter != topNode->edges.end(); edgIter ++) {
+			static Regex* CompileFilter(const string& pattern, const char* option) {
+				Regex* filter = new Regex(pattern);
+				string error;
+				if (!filter->isValid(error)) report_fatal_error(Twine("invalid ") + option + " regex: " + error);
+				return filter;
+			}
 
-					if (edgIter->backEdge) continue; //ignore backedges
+			static string LoopLocation(Loop* L) {	//file:line of the loop header, empty without debug info
+				BasicBlock* header = L->getHeader();
+				for (BasicBlock::iterator ins = header->begin(), ie = header->end(); ins != ie; ins ++) {
+					DebugLoc loc = ins->getDebugLoc();
+					if (loc.isUnknown()) continue;
+					DIScope scope(loc.getScope(header->getContext()));
+					string where;
+					raw_string_ostream os(where);
+					os << scope.getFilename() << ":" << loc.getLine();
+					return os.str();
+				}
+				return "";
+			}
 
-					bool backedge = false;		//if child is in stack already, we have detected a backedge
+			bool SelectLoop(Loop* L) {	//the filters known before the weights, a loop left out here is never looked at again
+				bool selected = funcSelected;
+				if (selected && DFGLoops.size())
+					selected = find(DFGLoops.begin(), DFGLoops.end(), loopID) != DFGLoops.end();
+				if (selected && locFilter)
+					selected = locFilter->match(LoopLocation(L));
+				if (!selected) NumLoopsSkipped ++;
+				return selected;
+			}
 
-					for (list<clust_node*>::iterator stackIter = nodeStack.begin(); stackIter != nodeStack.end(); stackIter ++)	{
-						if (*stackIter != edgIter->target) continue;
-						backedge = true;
-						break;
-					}//if child is in stack already, we have detected a backedge
+			void SelectHotLoops() {	//coverage threshold and top N, once the coverage of every loop is known
+				vector<pair<double, unsigned int> > hot;	//coverage, position in candidates
+				for (unsigned int c = 0; c < candidates.size(); c ++)
+					if (candidates[c].cov >= DFGMinCoverage) hot.push_back(make_pair(candidates[c].cov, c));
+				if (DFGTop && hot.size() > DFGTop) {	//hottest first, the earlier loop on a tie
+					std::sort(hot.begin(), hot.end(), HotterLoop());
+					hot.resize(DFGTop);
+				}
 
-					if (backedge) {	//mark edge as backedge
-						edgIter->backEdge = true;
-						topNode->nBackEdgesOut ++;
-						for (list<clust_edge>::iterator edgIter2 = edgIter->target->outgoingEdges.begin();
-								edgIter2 != edgIter->target->outgoingEdges.end(); edgIter2 ++) {
+				for (unsigned int c = 0; c < candidates.size(); c ++) candidates[c].selected = false;
+				for (unsigned int h = 0; h < hot.size(); h ++) candidates[hot[h].second].selected = true;
+				NumLoopsSkipped += candidates.size() - hot.size();
+			}
 
-							if (edgIter2->target != topNode) continue;
-							edgIter2->backEdge = true;
-							edgIter->target->nBackEdgesIn ++;
-							break;
-						}
-					}//mark edge as backedge
+			void WeighLoop(Loop* L) {	//number the loops and weigh the innermost ones the filters select
+				for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I) {
+					WeighLoop(*I);
+				}
 
-					else //push child
-					{
-						nodeStack.push_back(edgIter->target);
-						edgIter->target->visited = true;
-						RemoveCycle(nodeStack);
-					}//push child
-				}//process children
+				if (L->getSubLoops().empty() && SelectLoop(L)) {
+					loop_candidate candidate;
+					candidate.id = loopID;
+					candidate.wt = 0;
+					for (Loop::block_iterator bi = L->block_begin(), be = L->block_end(); bi != be; ++bi)
+						candidate.wt += BlockWeight(*bi) * (*bi)->size();
+					candidate.cov = 0;
+					candidate.selected = false;
+					candidates.push_back(candidate);
+				}
 
-				nodeStack.pop_back();
-			}//RemoveCycle
+				loopID ++;
+			}
 
-			bool WriteLoopGraph(unsigned int id, double cov) {
+			static bool HasCycle(const Function& F) {	//a DFS over the CFG, much cheaper than the dominator tree LoopInfo needs
+				SmallVector<pair<const BasicBlock*, const BasicBlock*>, 8> backEdges;
+				FindFunctionBackedges(F, backEdges);
+				return !backEdges.empty();
+			}
 
-				map <unsigned int, clust_graph>::iterator loopGraph = graphs.find (id); //get loop graph
-				assert (loopGraph != graphs.end());
+			double BlockWeight(BasicBlock* bbl) const {	//executions of the block per call of its function
+				return (double)BFI->getBlockFreq(bbl).getFrequency() / BlockFrequency::getEntryFrequency();
+			}
 
-				char fileName[256];	//create file name
-				sprintf(fileName, "%u.loop_analysis_graph.graph", id);
+			unsigned int NumThreads() const {
+				return (DFGThreads == 0) ? HardwareThreads() : (unsigned int)DFGThreads;
+			}
 
-				unsigned int maxDepth = 0; //calculate depths, should not exceed no of nodes
+			void PrintMemReport() const {
+				fprintf(stderr, "loop graphs built: %u\n", nGraphs);
+				fprintf(stderr, "largest loop graph: %lu bytes (loop %u)\n", (unsigned long)maxGraphBytes, maxGraphLoop);
+				fprintf(stderr, "peak RSS: %ld KB\n", PeakRSSKB());
+			}
 
-				//we do not really need depth we need to remove the cycles
+			static void PrintStats(FILE* rf, const loop_stats& stats) {	//the counters and times of a JSON report entry
+				fprintf(rf, "\"nodes\": %u, \"edges\": %u, \"dataNodes\": %u, \"gepsExpanded\": %u, \"backEdges\": %u, "
+						"\"memDeps\": %u, \"affineAccesses\": %u, \"addressElided\": %u, \"allocations\": %u, \"bytesWritten\": %llu, ",
+						stats.nodes, stats.edges, stats.dataNodes, stats.gepsExpanded, stats.backEdges,
+						stats.memDeps, stats.affineAccesses, stats.addressElided, stats.allocations, stats.bytesWritten);
+				for (unsigned int k = 0; optPipeline.NumPasses() && k < NUM_OPT_PASSES; k ++)	//removed by each optimization pass
+					fprintf(rf, "%s\"%s\": {\"nodes\": %u, \"edges\": %u}%s", k ? ", " : "\"opt\": {", graph_pipeline::PassName((opt_pass_kind)k),
+							stats.optNodes[k], stats.optEdges[k], (k + 1 < NUM_OPT_PASSES) ? "" : "}, ");
+				fprintf(rf, "\"time\": {");
+				for (unsigned int p = 0; p < NUM_PHASES; p ++)
+					fprintf(rf, "%s\"%s\": %.6lf", p ? ", " : "", phaseNames[p], stats.time[p]);
+				fprintf(rf, "}");
+			}
 
-				list <clust_node*> nodeStack;
+			void WriteReport() const {	//JSON report of all loops built, in loop order, and their totals
+				FILE* rf = fopen(DFGReport.c_str(), "w");
+				if (!rf) {
+					fprintf(stderr, "cannot write %s\n", DFGReport.c_str());
+					return;
+				}
 
-				for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++) { //initialize
+				std::sort(loopStats.begin(), loopStats.end(), StatsLess());	//loops finish in any order on several threads
+				loop_stats total;
+				memset(&total, 0, sizeof(total));
+				unsigned int scheduled = 0, timeouts = 0;	//loops given a modulo schedule and loops that ran out of time
+				unsigned int mapped = 0, mapTimeouts = 0;	//the same for the CGRA mapping
+
+				fprintf(rf, "{\"loops\": [");
+				for (unsigned int l = 0; l < loopStats.size(); l ++) {
+					const loop_stats& stats = loopStats[l];
+					fprintf(rf, "%s\n{\"id\": %u, \"coverage\": %.5lf, \"criticalPath\": %u, \"recMII\": %u, \"cached\": %s, ",
+							l ? "," : "", stats.id, stats.cov, stats.criticalPath, stats.recMII, stats.cached ? "true" : "false");
+					if (scheduler)	//of the final graph
+						fprintf(rf, "\"schedule\": {\"ii\": %u, \"resMII\": %u, \"recMII\": %u, \"stages\": %u, \"timedOut\": %s}, ",
+								stats.ii, stats.resMII, stats.scheduleRecMII, stats.stages, stats.timedOut ? "true" : "false");
+					if (mapper)
+						fprintf(rf, "\"map\": {\"ii\": %u, \"resMII\": %u, \"recMII\": %u, \"fuUse\": %.3f, \"linkUse\": %.3f, "
+								"\"registerUse\": %.3f, \"timedOut\": %s}, ", stats.mapII, stats.mapResMII, stats.mapRecMII,
+								stats.fuUse, stats.linkUse, stats.registerUse, stats.mapTimedOut ? "true" : "false");
+					PrintStats(rf, stats);
+					fprintf(rf, "}");
+
+					total.nodes += stats.nodes;
+					total.edges += stats.edges;
+					total.dataNodes += stats.dataNodes;
+					total.gepsExpanded += stats.gepsExpanded;
+					total.backEdges += stats.backEdges;
+					total.memDeps += stats.memDeps;
+					total.affineAccesses += stats.affineAccesses;
+					total.addressElided += stats.addressElided;
+					for (unsigned int k = 0; k < NUM_OPT_PASSES; k ++) {
+						total.optNodes[k] += stats.optNodes[k];
+						total.optEdges[k] += stats.optEdges[k];
+					}
+					scheduled += (stats.ii > 0);
+					timeouts += stats.timedOut;
+					mapped += (stats.mapII > 0);
+					mapTimeouts += stats.mapTimedOut;
+					total.allocations += stats.allocations;
+					total.bytesWritten += stats.bytesWritten;
+					for (unsigned int p = 0; p < NUM_PHASES; p ++) total.time[p] += stats.time[p];
+				}
 
-					nodeIter->second.visited = false;
-					nodeIter->second.nBackEdgesIn = 0;
-					nodeIter->second.nBackEdgesOut = 0;
+				fprintf(rf, "\n], \"module\": {\"loops\": %lu, \"threads\": %u, \"cacheHits\": %u, ",
+						(unsigned long)loopStats.size(), NumThreads(), cacheHits);
+				if (scheduler) fprintf(rf, "\"scheduled\": %u, \"scheduleTimeouts\": %u, ", scheduled, timeouts);
+				if (mapper) fprintf(rf, "\"mapped\": %u, \"mapTimeouts\": %u, ", mapped, mapTimeouts);
+				PrintStats(rf, total);
+				fprintf(rf, ", \"peakRSSKB\": %ld}}\n", PeakRSSKB());
+				fclose(rf);
+			}
+
+			bool Deferred() const {		//loops are built on the pool
+				return NumThreads() > 1;
+			}
+
+			void ComputeCtrlDeps(Function& F) {	//control dependences of the whole function from its post-dominator tree
+
+				// Ferrante-Ottenstein-Warren: for each branch edge A -> S, every block on the
+				// post-dominator tree path from S up to (excluding) ipdom(A) post-dominates S
+				// but not A, i.e. it is control dependent on A through that successor.
+				postDom.recalculate(F);
+				DominatorTreeBase<BasicBlock>* PDT = &postDom;
+				ctrlDeps.clear();
+
+				for (Function::iterator bi = F.begin(), be = F.end(); bi != be; bi ++) {
+					BasicBlock* bbl = &*bi;
+					TerminatorInst* tail = bbl->getTerminator();
+					if (!tail || tail->getNumSuccessors() != 2) continue;	//only two way branches create control dependences
+
+					DomTreeNode* bblNode = PDT->getNode(bbl);
+					DomTreeNode* stop = bblNode ? bblNode->getIDom() : 0;
+					vector<ctrl_dep>& deps = ctrlDeps[bbl];
+
+					for (unsigned int s = 0; s < 2; s ++) {
+						for (DomTreeNode* runner = PDT->getNode(tail->getSuccessor(s)); runner && runner != stop; runner = runner->getIDom()) {
+							if (!runner->getBlock()) break;	//virtual root of a multi-exit function
+							ctrl_dep dep;
+							dep.block = runner->getBlock();
+							dep.succ = s;
+							deps.push_back(dep);
+						}
+					}
 				}
+				ctrlDepFunc = &F;
+			}
+
+			void CollectCtrlDeps(Loop* L, const DenseMap<BasicBlock*, unsigned int>& loopPos, loop_task& task) {	//control dependences inside the loop, by block position
+				Function* F = L->getHeader()->getParent();
+				if (ctrlDepFunc != F) ComputeCtrlDeps(*F);	//computed once per function
+
+				const vector<BasicBlock*>& blocks = task.blocks;
 
-				for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++) { //start DFS
+				for (unsigned int b = 0; b < blocks.size(); b ++) {
+					ctrl_dep_map::iterator deps = ctrlDeps.find(blocks[b]);
+					if (deps == ctrlDeps.end()) continue;
 
-					if (nodeIter->second.visited) continue;		//init stack
-					nodeStack.push_back(&(nodeIter->second));
-					nodeIter->second.visited = true;
-					RemoveCycle(nodeStack);
+					BitVector reached[2];	//loop blocks reached from each successor within the iteration
+					TerminatorInst* branch = blocks[b]->getTerminator();
+					for (unsigned int s = 0; s < 2; s ++) {	//only two way branches have dependent blocks
+						reached[s].resize(blocks.size());
+						if (branch->getSuccessor(s) != L->getHeader()) ReachInIteration(L, loopPos, branch->getSuccessor(s), reached[s]);
+					}
 
-				}//DFS
+					for (unsigned int d = 0; d < deps->second.size(); d ++) {
+						const ctrl_dep& dep = deps->second[d];
+						if (dep.block == blocks[b]) continue;		//check distinct blocks
+						DenseMap<BasicBlock*, unsigned int>::const_iterator pos = loopPos.find(dep.block);
+						if (pos == loopPos.end()) continue;	//outside the loop
+
+						loop_ctrl_dep loopDep;
+						loopDep.branch = b;
+						loopDep.dependent = pos->second;
+						loopDep.succ = dep.succ;
+						loopDep.distance = reached[dep.succ].test(pos->second) ? 0 : 1;
+						task.ctrlDeps.push_back(loopDep);
+					}
+				}
+				std::sort(task.ctrlDeps.begin(), task.ctrlDeps.end(), CtrlDepLess());
+			}
 
-				FILE* lf = fopen(fileName, "w");	//open file
+			// Memory dependences between the loads and stores of L, by instruction position in the
+			// loop. Pairs that alias analysis proves disjoint are not asked; for the others the
+			// direction at the level of L tells the edges: = a dependence within an iteration,
+			// from the earlier to the later operation, < a loop-carried one in the same direction,
+			// > a loop-carried one from the later operation to the earlier. A dependence whose
+			// direction at an enclosing loop excludes = does not occur in one run of L.
+			void CollectMemDeps(Loop* L, const DenseMap<BasicBlock*, unsigned int>& loopPos, loop_task& task) {
+				vector<Instruction*> memOps;
+				vector<unsigned int> memPos;	//position among the instructions of the loop
+				vector<unsigned int> memBlock;
+				unsigned int pos = 0;
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+					for (BasicBlock::iterator ins = task.blocks[b]->begin(), ie = task.blocks[b]->end(); ins != ie; ins ++, pos ++) {
+						if (!isa<LoadInst>(&*ins) && !isa<StoreInst>(&*ins)) continue;
+						memOps.push_back(&*ins);
+						memPos.push_back(pos);
+						memBlock.push_back(b);
+					}
+				}
+				task.memOps = memOps.size();
+				if (memOps.size() > DFGMemDepLimit) {
+					NumMemDepLoopsSkipped ++;
+					return;
+				}
 
-				fprintf(lf, "%lu\t%u\t%.5lf\n", loopGraph->second.size(), maxDepth, cov);	//print no of vertices
+				vector<BitVector> reached(task.blocks.size());	//blocks that can follow each block in one iteration
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) ReachInIteration(L, loopPos, task.blocks[b], reached[b]);
+
+				unsigned int level = L->getLoopDepth();
+				for (unsigned int i = 0; i < memOps.size(); i ++) {
+					for (unsigned int j = i + 1; j < memOps.size(); j ++) {
+						if (isa<LoadInst>(memOps[i]) && isa<LoadInst>(memOps[j])) continue;	//reads do not depend on each other
+						if (AA->alias(MemLocation(memOps[i]), MemLocation(memOps[j])) == AliasAnalysis::NoAlias) continue;
+
+						// i comes first in an iteration if its block leads to the block of j
+						bool ordered = (memBlock[i] == memBlock[j]) || reached[memBlock[i]].test(memBlock[j]);
+						NumMemDepQueries ++;
+						Dependence* dep = DA->depends(memOps[i], memOps[j], ordered);
+						if (!dep) continue;
+
+						unsigned int dir = Dependence::DVEntry::ALL;
+						const SCEV* distance = 0;
+						bool inRun = true;	//the dependence can occur within one run of L
+						if (!dep->isConfused() && dep->getLevels() >= level) {
+							for (unsigned int outer = 1; outer < level; outer ++)
+								if (!(dep->getDirection(outer) & Dependence::DVEntry::EQ)) inRun = false;
+							dir = dep->getDirection(level);
+							distance = dep->getDistance(level);
+						}
+						clust_dep kind = dep->isOutput() ? MEMDEP_OUTPUT : (dep->isFlow() ? MEMDEP_FLOW : MEMDEP_ANTI);
+						delete dep;
+						if (!inRun) continue;
+
+						if (ordered && (dir & Dependence::DVEntry::EQ)) AddMemDep(task, memPos[i], memPos[j], kind, 0, distance);
+						else if (dir & Dependence::DVEntry::LT) AddMemDep(task, memPos[i], memPos[j], kind, 1, distance);
+						if (dir & Dependence::DVEntry::GT) {	//the later operation comes first, across iterations
+							clust_dep reversed = (kind == MEMDEP_FLOW) ? MEMDEP_ANTI : ((kind == MEMDEP_ANTI) ? MEMDEP_FLOW : kind);
+							AddMemDep(task, memPos[j], memPos[i], reversed, -1, distance);
+						}
+					}
+				}
+				std::sort(task.memDeps.begin(), task.memDeps.end(), MemDepLess());
+			}
 
-				//print each vertex in order of id visit nodes in order of id
-				for (unsigned int idCtr = 1; idCtr <= loopGraph->second.size(); idCtr ++) {
-					for (map<Value*, clust_node>::iterator nodeIter = loopGraph->second.begin(); nodeIter != loopGraph->second.end(); nodeIter ++) {
+			// sign 0: within an iteration; 1 or -1: loop-carried, by distance times sign if it is a constant
+			void AddMemDep(loop_task& task, unsigned int src, unsigned int dst, clust_dep kind, int sign, const SCEV* distance) {
+				loop_mem_dep dep;
+				dep.src = src;
+				dep.dst = dst;
+				dep.kind = kind;
+				dep.distance = 0;
+				dep.unknownDistance = false;
+				if (sign != 0) {
+					const SCEVConstant* constant = dyn_cast_or_null<SCEVConstant>(distance);
+					int64_t iterations = constant ? constant->getValue()->getSExtValue() * sign : 0;
+					dep.unknownDistance = (iterations <= 0);
+					dep.distance = dep.unknownDistance ? 1 : iterations;
+				}
+				task.memDeps.push_back(dep);
+			}
 
-						if (nodeIter->second.id != idCtr) continue;
+			AliasAnalysis::Location MemLocation(Instruction* ins) {
+				if (LoadInst* load = dyn_cast<LoadInst>(ins)) return AA->getLocation(load);
+				return AA->getLocation(cast<StoreInst>(ins));
+			}
 
-						if ((nodeIter->second.nodeType == INSTNODE) && (!nodeIter->second.isLoad)) {
+			// Loads and stores of L whose address ScalarEvolution gives as {base,+,stride} in L, with a
+			// base invariant in L and a constant stride, or as invariant in L (stride 0). An address unit
+			// generates them, so the instructions that only compute their addresses are elided: the
+			// side effect free instructions they are computed from whose every use is another elided
+			// instruction or such an address. An induction variable that also steers the exit stays.
+			void CollectAffineAccesses(Loop* L, loop_task& task) {
+				DenseMap<Value*, unsigned int> insPos;	//position of each instruction of the loop
+				vector<Instruction*> loopIns;
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+					for (BasicBlock::iterator ins = task.blocks[b]->begin(), ie = task.blocks[b]->end(); ins != ie; ins ++) {
+						insPos[&*ins] = loopIns.size();
+						loopIns.push_back(&*ins);
+					}
+				}
+
+				BitVector isAccess(loopIns.size());
+				vector<unsigned int> work;
+				for (unsigned int pos = 0; pos < loopIns.size(); pos ++) {
+					Instruction* ins = loopIns[pos];
+					if (!isa<LoadInst>(ins) && !isa<StoreInst>(ins)) continue;
+					Value* address = ins->getOperand(AddressOperand(ins));
+					if (!SE->isSCEVable(address->getType())) continue;
+
+					const SCEV* start = SE->getSCEV(address);
+					int64_t stride = 0;
+					if (!SE->isLoopInvariant(start, L)) {
+						const SCEVAddRecExpr* rec = dyn_cast<SCEVAddRecExpr>(start);
+						if (!rec || rec->getLoop() != L || !rec->isAffine() || !SE->isLoopInvariant(rec->getStart(), L)) continue;
+						const SCEVConstant* step = dyn_cast<SCEVConstant>(rec->getStepRecurrence(*SE));
+						if (!step) continue;
+						start = rec->getStart();
+						stride = step->getValue()->getSExtValue();
+					}
 
-							fprintf(lf, "%u\t%.0lf\tC\t%c", nodeIter->second.depth, nodeIter->second.wt, nodeIter->second.type);
+					loop_affine_access access;
+					access.pos = pos;
+					access.stride = stride;
+					access.base = SCEVText(start);
+					task.accesses.push_back(access);
+					isAccess.set(pos);
 
-							fprintf(lf, "\t%ld", ((long)nodeIter->second.edges.size()) - nodeIter->second.nBackEdgesOut);//print no of outgoing edges
-						}//compute node
-						else if (nodeIter->second.nodeType == INSTNODE) {
-							fprintf(lf, "%u\t%.0lf\tM\t%c", nodeIter->second.depth, nodeIter->second.wt, nodeIter->second.type);
-							fprintf(lf, "\t%ld", ((long)nodeIter->second.edges.size()) - nodeIter->second.nBackEdgesOut); //print no of outgoing edges
-						}//load node
-						else fprintf(lf, "%u\t%.0lf\tD\tN\t%ld", nodeIter->second.depth, nodeIter->second.wt,
-								((long)nodeIter->second.edges.size()) - nodeIter->second.nBackEdgesOut);
+					DenseMap<Value*, unsigned int>::iterator producer = insPos.find(address);
+					if (producer != insPos.end()) work.push_back(producer->second);
+				}
+				if (task.accesses.empty()) return;
+
+				const SCEV* taken = SE->getBackedgeTakenCount(L);
+				task.tripCount = isa<SCEVCouldNotCompute>(taken) ? "?" : SCEVText(SE->getAddExpr(taken, SE->getConstant(taken->getType(), 1)));
+
+				task.elided.resize(loopIns.size());	//first everything the addresses are computed from
+				while (!work.empty()) {
+					unsigned int pos = work.back();
+					work.pop_back();
+					Instruction* ins = loopIns[pos];
+					if (task.elided.test(pos) || ins->mayReadOrWriteMemory() || ins->mayHaveSideEffects() || isa<TerminatorInst>(ins)) continue;
+					task.elided.set(pos);
+					for (User::op_iterator opnd = ins->op_begin(), oe = ins->op_end(); opnd != oe; opnd ++) {
+						DenseMap<Value*, unsigned int>::iterator producer = insPos.find(opnd->get());
+						if (producer != insPos.end()) work.push_back(producer->second);
+					}
+				}
 
-						//for each edge
-						for (list<clust_edge>::iterator edgIter = nodeIter->second.edges.begin(); edgIter != nodeIter->second.edges.end();
-								edgIter ++)
-						{
-							if (edgIter->backEdge) continue;
+				for (int pos = task.elided.find_first(); pos >= 0; pos = task.elided.find_next(pos)) work.push_back(pos);
+				while (!work.empty()) {	//then keep those with another use, and what they are computed from in turn
+					unsigned int pos = work.back();
+					work.pop_back();
+					Instruction* ins = loopIns[pos];
+					if (!task.elided.test(pos) || OnlyAddress(ins, insPos, isAccess, task.elided)) continue;
+					task.elided.reset(pos);
+					for (User::op_iterator opnd = ins->op_begin(), oe = ins->op_end(); opnd != oe; opnd ++) {
+						DenseMap<Value*, unsigned int>::iterator producer = insPos.find(opnd->get());
+						if (producer != insPos.end() && task.elided.test(producer->second)) work.push_back(producer->second);
+					}
+				}
+			}
 
-							if (edgIter->depType == DATADEP)
-								fprintf(lf, "\t%u\tD\t%.0lf", edgIter->target->id, edgIter->target->wt);
-							else if (edgIter->depType == CTRLDEP_0)
-								fprintf(lf, "\t%u\tY\t%.0lf", edgIter->target->id, edgIter->target->wt);
-							else
-								fprintf(lf, "\t%u\tN\t%.0lf", edgIter->target->id, edgIter->target->wt);
-						}//for each edge
+			// every use of ins is an elided instruction or the address of an affine access
+			static bool OnlyAddress(Instruction* ins, const DenseMap<Value*, unsigned int>& insPos, const BitVector& isAccess, const BitVector& elided) {
+				for (Value::use_iterator use = ins->use_begin(), ue = ins->use_end(); use != ue; ++use) {
+					DenseMap<Value*, unsigned int>::const_iterator user = insPos.find(*use);
+					if (user == insPos.end()) return false;	//used after the loop
+					if (elided.test(user->second)) continue;
+					if (!isAccess.test(user->second) || use.getOperandNo() != AddressOperand(*use)) return false;
+				}
+				return true;
+			}
 
-						fprintf(lf, "\t%ld", ((long)nodeIter->second.outgoingEdges.size()) - nodeIter->second.nBackEdgesIn);
+			// The address arithmetic of every GEP that gets a node, from the sizes of DataLayout:
+			// struct fields and constant indices add up to one offset, the other indices are
+			// scaled by the size of the type they step over. Struct layouts are cached in the
+			// DataLayout as they are asked for, so this is done here rather than by the builders.
+			// GEPs of vectors of pointers are left as they are.
+			void CollectGEPs(loop_task& task) {
+				unsigned int pos = 0;
+				for (unsigned int b = 0; b < task.blocks.size(); b ++) {
+					for (BasicBlock::iterator ins = task.blocks[b]->begin(), ie = task.blocks[b]->end(); ins != ie; ins ++, pos ++) {
+						GetElementPtrInst* gepIns = dyn_cast<GetElementPtrInst>(&*ins);
+						if (!gepIns || gepIns->getType()->isVectorTy() || (pos < task.elided.size() && task.elided.test(pos))) continue;
+
+						loop_gep gep;
+						gep.pos = pos;
+						gep.offset = 0;
+						gep.firstIndex = task.gepIndices.size();
+						unsigned int operand = 1;
+						for (gep_type_iterator GTI = gep_type_begin(gepIns), GE = gep_type_end(gepIns); GTI != GE; ++GTI, operand ++) {
+							ConstantInt* index = dyn_cast<ConstantInt>(GTI.getOperand());
+							if (StructType* st = dyn_cast<StructType>(*GTI)) {	//field numbers are constants
+								gep.offset += DL->getStructLayout(st)->getElementOffset(index->getZExtValue());
+								continue;
+							}
+							uint64_t scale = DL->getTypeAllocSize(GTI.getIndexedType());
+							if (index) gep.offset += index->getSExtValue() * (int64_t)scale;
+							else if (scale) {	//an index over a type of size 0 adds nothing
+								loop_gep_index var;
+								var.operand = operand;
+								var.scale = scale;
+								task.gepIndices.push_back(var);
+							}
+						}
+						gep.nIndices = task.gepIndices.size() - gep.firstIndex;
+						task.geps.push_back(gep);
+					}
+				}
+			}
 
-						for (list<clust_edge>::iterator edgIter = nodeIter->second.outgoingEdges.begin(); 	//for each incoming edge
-								edgIter != nodeIter->second.outgoingEdges.end(); edgIter ++)
-						{
-							if (edgIter->backEdge) continue;
-							if (edgIter->depType == DATADEP)
-								fprintf(lf, "\t%u\tD\t%.0lf", edgIter->target->id, edgIter->target->wt);
-							else if (edgIter->depType == CTRLDEP_0)
-								fprintf(lf, "\t%u\tY\t%.0lf", edgIter->target->id, nodeIter->second.wt);
-							else fprintf(lf, "\t%u\tN\t%.0lf", edgIter->target->id, nodeIter->second.wt);
-						}//for each incoming edge
+			static string SCEVText(const SCEV* expr) {
+				string text;
+				raw_string_ostream os(text);
+				os << *expr;
+				return os.str();
+			}
 
-						fprintf(lf, "\n");
-						break;
-					}//for each node
-				}//for each id
-				return 1;
-			}//WriteLoopGraph
+			// blocks of L reached from start without going through the header again, by position in
+			// the loop; a block depending on a branch that is not among them runs in the next iteration
+			void ReachInIteration(Loop* L, const DenseMap<BasicBlock*, unsigned int>& loopPos, BasicBlock* start, BitVector& reached) {
+				reached.resize(loopPos.size());
+				if (!loopPos.count(start)) return;
+
+				SmallVector<BasicBlock*, 16> work(1, start);
+				reached.set(loopPos.lookup(start));
+				while (!work.empty()) {
+					BasicBlock* bb = work.pop_back_val();
+					for (succ_iterator succ = succ_begin(bb), se = succ_end(bb); succ != se; ++succ) {
+						DenseMap<BasicBlock*, unsigned int>::const_iterator pos = loopPos.find(*succ);
+						if (*succ == L->getHeader() || pos == loopPos.end() || reached.test(pos->second)) continue;
+						reached.set(pos->second);
+						work.push_back(*succ);
+					}
+				}
+			}
 	};
 }
 
+char LoopGraphFunctionAnalyses::ID = 0;
+static RegisterPass<LoopGraphFunctionAnalyses> X("loop-graph-function-analyses", "function analyses that weigh the loop graphs", false, true);
+char LoopGraphMemoryAnalyses::ID = 0;
+static RegisterPass<LoopGraphMemoryAnalyses> Y("loop-graph-memory-analyses", "function analyses of the selected loop graphs", false, true);
 char LoopGraphAnalysisPass_0::ID = 0;
 static RegisterPass<LoopGraphAnalysisPass_0> Z("loop-graph-analysis-0", "form program graphs and analyze");
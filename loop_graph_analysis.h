@@ -28,8 +28,14 @@
 #define _LOOP_GRAPH_ANALYSIS_H_ 1
 
 #include "llvm/Support/CFG.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/DataTypes.h"
 #include <map>
 #include <list>
+#include <string>
+#include <vector>
+#include <assert.h>
 
 using namespace llvm;
 using namespace std;
@@ -38,7 +44,10 @@ typedef enum
 {
 	DATADEP,
 	CTRLDEP_0,
-	CTRLDEP_1
+	CTRLDEP_1,
+	MEMDEP_FLOW,	//store, then a load of the same location
+	MEMDEP_ANTI,	//load, then a store
+	MEMDEP_OUTPUT	//store, then a store
 }clust_dep;
 
 /*typedef enum
@@ -55,6 +64,66 @@ typedef enum
 
 }clust_nodeLat;
 */
+typedef struct
+{
+	BasicBlock* block;	//block that is control dependent on a branch
+	unsigned int succ;	//successor of the branch through which it depends
+}ctrl_dep;
+
+typedef struct
+{
+	unsigned int branch;	//position of the branching block in the loop
+	unsigned int dependent;	//position of the block control dependent on it
+	unsigned int succ;	//successor of the branch through which it depends
+	unsigned int distance;	//1 if the dependent block is only reached through the header, i.e. in the next iteration
+}loop_ctrl_dep;
+
+typedef struct
+{
+	unsigned int src;	//position of the earlier memory operation among the instructions of the loop
+	unsigned int dst;	//position of the later one
+	clust_dep kind;	//MEMDEP_*
+	unsigned int distance;	//iterations from src to dst, 1 if unknownDistance
+	bool unknownDistance;	//loop-carried by an unknown number of iterations
+}loop_mem_dep;
+
+typedef struct
+{
+	unsigned int pos;	//position of the load or store among the instructions of the loop
+	int64_t stride;	//bytes the address moves from one iteration to the next
+	string base;	//address in the first iteration, as printed by ScalarEvolution
+}loop_affine_access;	//address {base,+,stride} of a load or store, generated by a streaming address unit
+
+typedef struct
+{
+	unsigned int operand;	//operand number of the index in the GEP
+	uint64_t scale;	//bytes per unit of the index, the allocation size of the type it steps over
+}loop_gep_index;
+
+typedef struct
+{
+	unsigned int pos;	//position of the GEP among the instructions of the loop
+	int64_t offset;	//bytes added by the constant indices and the struct fields
+	unsigned int firstIndex;	//its variable indices are gepIndices[firstIndex, firstIndex + nIndices), in operand order
+	unsigned int nIndices;
+}loop_gep;	//a GEP as the adds, multiplies and shifts of its address, see DataLayout
+
+typedef struct
+{
+	unsigned int id;	//loop id, numbered in program order
+	vector<BasicBlock*> blocks;	//blocks of the loop, in loop order
+	vector<loop_ctrl_dep> ctrlDeps;	//control dependences, sorted by branch then dependent
+	vector<loop_mem_dep> memDeps;	//memory dependences between loads and stores, sorted by src then dst
+	unsigned int memOps;	//loads and stores of the loop; memDeps is left empty if there are more than -dfg-mem-dep-limit
+	vector<loop_affine_access> accesses;	//with -dfg-affine, sorted by pos
+	BitVector elided;	//with -dfg-affine, instructions that only compute affine addresses and get no node, by position
+	string tripCount;	//iterations per run of the loop, as printed by ScalarEvolution, ? if unknown; empty without accesses
+	vector<loop_gep> geps;	//GEP instructions that get a node, sorted by pos
+	vector<loop_gep_index> gepIndices;
+	vector<double> blockWt;	//executions of each block per call of the function
+	double cov;	//share of the dynamic instructions of the module executed in the loop
+}loop_task;	//everything needed to build the graph of an innermost loop, taken from the analyses
+
 typedef enum
 {
 	DATANODE,
@@ -62,47 +131,157 @@ typedef enum
 }clust_nodeType;
 
 typedef enum {
-	GEP_MULT,
-	GEP_ADD1,
-	GEP_ADD2,
-	GEP_SIZE
+	GEP_MULT,	//index times a scale that is not a power of two
+	GEP_ADD1,	//last add, gives the address
+	GEP_ADD2,	//add of a scaled index to the address so far
+	GEP_SHL	//index shifted by the log2 of its scale
 } gep_nodeType;
 
-struct my_clust_node;
+typedef enum {
+	FU_NONE,	//needs no unit: PHIs and data nodes
+	FU_ALU,
+	FU_MUL,
+	FU_MEM,
+	FU_FP,
+	NUM_FU_CLASSES
+} fu_class;	//functional unit an operation runs on, see latency_model.h
 
 typedef struct
 {
-	struct my_clust_node* target;
+	unsigned int src;	//index of the producer node
+	unsigned int dst;	//index of the consumer node
 	clust_dep depType;
 	double wt; //weight of edges
 	unsigned int id;
-	bool backEdge;
-	unsigned int gepTargetID;
+	unsigned int distance;	//iterations from producer to consumer, 0 within an iteration
+	bool unknownDistance;	//memory dependence carried by an unknown number of iterations, distance is 1
+	bool backEdge;	//loop-carried (distance > 0), a recurrence edge left out of the levels
+	bool removed;	//edge has been deleted, e.g. by GEP expansion
 
 }clust_edge;
 
-typedef struct my_clust_node
+typedef struct
 {
 	Value* ins;
-	list<clust_edge> edges;
-	list<clust_edge> outgoingEdges;
 	unsigned int id;
 	bool entryNode;
 	bool ifAny;
 	double wt; //weight of node, i.e. no of time operation executes
 	clust_nodeType nodeType;
-	bool  lvisited;
-	list<clust_edge>::iterator nextEdgToVisit;
-	unsigned int depth;
+	unsigned int depth;	//ASAP level: earliest start, in cycles, after its producers finished
+	unsigned int slack;	//ALAP - ASAP level, 0 on a critical path
 	int latency;
+	unsigned int ii;	//initiation interval of the operation on its unit
+	fu_class fu;
 	char type; //int/float/vector
 	bool isLoad;
 	bool visited; //used in depth-first search
 	int nBackEdgesIn;
 	int nBackEdgesOut;
+	unsigned int scc;	//strongly connected component, nodes on a common recurrence share it
+	bool removed;	//node has been deleted, e.g. a GEP that was expanded
+	bool gepNode;	//node was created by GEP expansion
 	gep_nodeType gepNodeType;
+	int64_t gepImm;	//immediate of a GEP expansion node: offset of an add, scale of a mult, shift of a shl; 0 if none
+	const loop_affine_access* access;	//affine address of a load or store, which then has no address operand; 0 if none
+	const char* label;	//operation of a fused node, e.g. muladd, see graph_opt.h; 0 for the opcode of ins
+	Value* imm;	//constant operand folded into the operation as an immediate, 0 if none
 } clust_node;
 
-typedef map<Value*, clust_node> clust_graph;
+// Loop graph with nodes in a dense array and edges in compressed sparse row
+// form. Nodes and edges are appended while the graph is being built; Finalize()
+// (re)builds the CSR offsets for both directions. Edges in a CSR row keep the
+// order in which they were added, edges added after the last Finalize() are not
+// in the rows yet. Deleted nodes and edges stay in the arrays with their
+// removed flag set, so indices are stable for the life of the graph.
+class clust_graph
+{
+	public:
+		clust_graph();
+
+		// Size all arrays for a graph of about nNodes nodes and nEdges edges, so that
+		// building it needs no further allocation. The storage of a loop graph is
+		// then a handful of blocks that are freed together with the graph.
+		void Reserve(unsigned int nNodes, unsigned int nEdges);
+
+		unsigned int AddNode(Value* ins, bool keyed);	//append a node, keyed nodes can be looked up by ins
+		unsigned int AddEdge(unsigned int src, unsigned int dst, clust_dep depType, double wt, unsigned int id);
+		void SetNodeID(unsigned int n, unsigned int id);	//assign the external id of a node
+		void RemoveEdge(unsigned int e);	//mark a single edge removed
+		void RemoveNode(unsigned int n);	//mark node and all its edges removed
+		void Finalize();	//rebuild the CSR arrays after edges were added
+
+		int Find(Value* ins) const;	//index of the node keyed by ins, -1 if absent
+		int NodeOfID(unsigned int id) const;	//index of the live node with this id, -1 if absent
+		unsigned int MaxID() const { return idIndex.size() - 1; }
+		bool HasEdge(unsigned int src, unsigned int dst) const;	//is there a live edge src -> dst
+
+		// Marks the loop-carried edges (distance > 0) as back-edges and assigns each node its
+		// SCC over all live edges. Every cycle of a loop graph has a loop-carried edge, so the
+		// graph without the back-edges is acyclic. Removed edges keep the mark they had.
+		unsigned int FindRecurrences();	//returns the number of back-edges marked
+		unsigned int NumSCCs() const { return nSCCs; }
+
+		// Recurrence-constrained minimum initiation interval: the largest latency / distance
+		// ratio, rounded up, of any cycle, found per SCC. 0 if the graph has no recurrence.
+		// Needs the SCCs of FindRecurrences().
+		unsigned int RecMII() const;
+
+		// ASAP levels (depth) and slack of the live nodes over the live edges that are not
+		// back-edges, weighted by node latency; one topological pass forward, one backward.
+		unsigned int Levelize();	//returns the critical path length, in cycles
+
+		unsigned int NumNodes() const { return nodes.size(); }	//including removed nodes
+		unsigned int NumEdges() const { return edges.size(); }	//including removed edges
+		unsigned int NumLiveNodes() const { return nodes.size() - nRemovedNodes; }
+		unsigned int NumLiveEdges() const { return edges.size() - nRemovedEdges; }
+
+		clust_node& Node(unsigned int n) { return nodes[n]; }
+		const clust_node& Node(unsigned int n) const { return nodes[n]; }
+		clust_edge& Edge(unsigned int e) { return edges[e]; }
+		const clust_edge& Edge(unsigned int e) const { return edges[e]; }
+
+		// out-edges of n (n is the producer) are OutEdge(k) for k in [OutBegin(n), OutEnd(n))
+		unsigned int OutBegin(unsigned int n) const { return outStart[n]; }
+		unsigned int OutEnd(unsigned int n) const { return outStart[n + 1]; }
+		unsigned int OutEdge(unsigned int k) const { return outList[k]; }
+
+		// in-edges of n (n is the consumer) are InEdge(k) for k in [InBegin(n), InEnd(n))
+		unsigned int InBegin(unsigned int n) const { return inStart[n]; }
+		unsigned int InEnd(unsigned int n) const { return inStart[n + 1]; }
+		unsigned int InEdge(unsigned int k) const { return inList[k]; }
+
+		size_t MemoryBytes() const;	//heap memory held by the graph
+		unsigned int NumAllocations() const { return nAllocations; }	//heap blocks allocated for the graph so far
+
+		unsigned int OutDegree(unsigned int n) const;	//live out-edges
+		unsigned int InDegree(unsigned int n) const;	//live in-edges
+
+	private:
+		vector<clust_node> nodes;
+		vector<clust_edge> edges;
+		vector<unsigned int> outStart;	//CSR offsets into outList, one per node plus one
+		vector<unsigned int> outList;	//edge indices grouped by src
+		vector<unsigned int> inStart;
+		vector<unsigned int> inList;	//edge indices grouped by dst
+		bool csrValid;
+		unsigned int nRemovedNodes;
+		unsigned int nRemovedEdges;
+		unsigned int nSCCs;
+		DenseMap<Value*, unsigned int> nodeIndex;	//Value* -> node index for keyed nodes
+		vector<int> idIndex;	//id -> node index, -1 for unused or removed ids
+		DenseMap<pair<unsigned int, unsigned int>, unsigned int> edgeCount;	//live edges per (src, dst)
+		unsigned int nAllocations;
+
+		template <class T> void CountGrowth(const vector<T>& v, size_t newSize) {	//call before v grows to newSize
+			if (newSize > v.capacity()) nAllocations ++;
+		}
+
+		unsigned int Latency(unsigned int n) const {	//cycles, negative latencies count as 0
+			return (nodes[n].latency > 0) ? nodes[n].latency : 0;
+		}
+
+		bool RecurrenceFits(const vector<unsigned int>& members, unsigned int ii, vector<long long>& start) const;
+};
 
 #endif //_LOOP_GRAPH_ANALYSIS_H_
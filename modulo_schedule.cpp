@@ -0,0 +1,299 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the modulo scheduler of the final loop graph.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "modulo_schedule.h"
+#include "llvm/Support/Timer.h"
+#include <queue>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	const unsigned int budgetRatio = 6;	//scheduling steps per operation for one II, Rau suggests 3 to 6
+	const unsigned int clockSteps = 256;	//steps between looks at the clock
+	const unsigned int noOp = ~0U;	//free unit in the reservation table
+
+	typedef struct
+	{
+		unsigned int node;	//index in the graph
+		fu_class fu;
+		unsigned int occupancy;	//cycles it holds its unit, 0 for none
+		unsigned int delay;	//latency, negative latencies count as 0
+		unsigned int height;	//longest path of delays to the end of the iteration, the priority
+	}sched_op;
+
+	typedef struct
+	{
+		unsigned int src;	//operations
+		unsigned int dst;
+		unsigned int distance;
+		unsigned int transfer;	//cycles added to the latency, see schedule_config
+	}sched_dep;
+
+	class ims_search {	//the operations and dependences of a loop and the state of the search for one II
+		public:
+			ims_search(const clust_graph& graph, const schedule_config& config) : config(config), ii(0), steps(0), timedOut(false) {
+				vector<unsigned int> opOf(graph.NumNodes(), noOp);
+				for (unsigned int n = 0; n < graph.NumNodes(); n ++) {
+					const clust_node& node = graph.Node(n);
+					if (node.removed || node.nodeType != INSTNODE) continue;
+					sched_op op;
+					op.node = n;
+					op.fu = node.fu;
+					op.occupancy = (node.fu == FU_NONE) ? 0 : max(node.ii, 1U);
+					op.delay = max(node.latency, 0);
+					op.height = 0;
+					opOf[n] = ops.size();
+					ops.push_back(op);
+				}
+
+				// dependences grouped by producer and by consumer, like the CSR of the graph
+				vector<unsigned int> order;	//operations without their back-edges in topological order, for the heights
+				vector<unsigned int> pending(ops.size(), 0);
+				outStart.assign(ops.size() + 1, 0);
+				inStart.assign(ops.size() + 1, 0);
+				for (unsigned int o = 0; o < ops.size(); o ++) {
+					for (unsigned int k = graph.OutBegin(ops[o].node); k != graph.OutEnd(ops[o].node); k ++) {
+						const clust_edge& edge = graph.Edge(graph.OutEdge(k));
+						if (edge.removed || opOf[edge.dst] == noOp || edge.dst == ops[o].node) continue;	//a self loop only bounds the II, see RecMII
+						sched_dep dep;
+						dep.src = o;
+						dep.dst = opOf[edge.dst];
+						dep.distance = edge.distance;
+						dep.transfer = (edge.depType < MEMDEP_FLOW && graph.Node(edge.src).scc != graph.Node(edge.dst).scc) ? config.transfer : 0;
+						deps.push_back(dep);
+						outStart[o + 1] ++;
+						inStart[dep.dst + 1] ++;
+						if (!dep.distance) pending[dep.dst] ++;
+					}
+				}
+				for (unsigned int o = 0; o < ops.size(); o ++) {
+					outStart[o + 1] += outStart[o];
+					inStart[o + 1] += inStart[o];
+					if (!pending[o]) order.push_back(o);
+				}
+				inList.resize(deps.size());
+				vector<unsigned int> next(inStart.begin(), inStart.end() - 1);
+				for (unsigned int d = 0; d < deps.size(); d ++) inList[next[deps[d].dst] ++] = d;	//deps are already grouped by src
+
+				for (unsigned int i = 0; i < order.size(); i ++) {
+					unsigned int o = order[i];
+					for (unsigned int d = outStart[o]; d < outStart[o + 1]; d ++)
+						if (!deps[d].distance && -- pending[deps[d].dst] == 0) order.push_back(deps[d].dst);
+				}
+				for (unsigned int i = order.size(); i -- > 0; ) {	//consumers first
+					sched_op& op = ops[order[i]];
+					unsigned int below = 0;
+					for (unsigned int d = outStart[order[i]]; d < outStart[order[i] + 1]; d ++)
+						if (!deps[d].distance) below = max(below, deps[d].transfer + ops[deps[d].dst].height);
+					op.height = op.delay + below;
+				}
+
+				unitStart[0] = 0;	//the units of class c are columns [unitStart[c], unitStart[c + 1]) of the reservation table
+				for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++)
+					unitStart[c + 1] = unitStart[c] + ((c == FU_NONE) ? 0 : config.units[c]);
+			}
+
+			unsigned int NumOps() const { return ops.size(); }
+			const sched_op& Op(unsigned int o) const { return ops[o]; }
+			bool TimedOut() const { return timedOut; }
+
+			unsigned int ResMII() const {
+				unsigned int used[NUM_FU_CLASSES] = {0};
+				for (unsigned int o = 0; o < ops.size(); o ++) used[ops[o].fu] += ops[o].occupancy;
+				unsigned int resMII = 0;
+				for (unsigned int c = 0; c < NUM_FU_CLASSES; c ++) {
+					if (c == FU_NONE || !used[c]) continue;
+					assert (config.units[c] > 0);
+					resMII = max(resMII, (used[c] + config.units[c] - 1) / config.units[c]);
+				}
+				return resMII;
+			}
+
+			unsigned int Delays() const {	//the II of a schedule that runs one operation at a time, one always exists
+				unsigned int sum = 0;
+				for (unsigned int o = 0; o < ops.size(); o ++) sum += max(max(ops[o].delay + config.transfer, ops[o].occupancy), 1U);
+				return sum;
+			}
+
+			// One attempt at ii: true if every operation got a cycle within the budget.
+			bool Run(unsigned int newII, double deadline) {
+				ii = newII;
+				time.assign(ops.size(), -1);
+				lastTime.assign(ops.size(), -1);
+				table.assign((size_t)ii * unitStart[NUM_FU_CLASSES], noOp);
+				queue = priority_queue<pair<unsigned int, unsigned int> >();
+				for (unsigned int o = 0; o < ops.size(); o ++) queue.push(make_pair(ops[o].height, ops.size() - o));	//ties in index order
+
+				unsigned int unscheduled = ops.size();
+				unsigned int budget = budgetRatio * ops.size();
+				while (unscheduled) {
+					unsigned int o = ops.size() - queue.top().second;
+					queue.pop();
+					if (time[o] >= 0) continue;	//placed again since it was queued
+					if (!budget --) return false;
+					if (deadline > 0 && ++ steps % clockSteps == 0 && TimeRecord::getCurrentTime(true).getWallTime() > deadline) {
+						timedOut = true;
+						return false;
+					}
+
+					int earliest = 0;	//all the producers placed so far are done
+					for (unsigned int k = inStart[o]; k < inStart[o + 1]; k ++) {
+						const sched_dep& dep = deps[inList[k]];
+						if (time[dep.src] >= 0) earliest = max(earliest, time[dep.src] + Latency(dep));
+					}
+					int t = earliest;
+					while (t < earliest + (int)ii && !Free(o, t)) t ++;
+					if (t == earliest + (int)ii) t = (lastTime[o] < 0 || earliest > lastTime[o]) ? earliest : lastTime[o] + 1;	//force it
+
+					unscheduled -= Place(o, t);
+				}
+				return true;
+			}
+
+			int Time(unsigned int o) const { return time[o]; }
+
+		private:
+			const schedule_config& config;
+			vector<sched_op> ops;
+			vector<sched_dep> deps;	//by producer
+			vector<unsigned int> outStart;	//deps of producer o are deps[outStart[o], outStart[o + 1])
+			vector<unsigned int> inStart;	//of consumer o deps[inList[k]] for k in [inStart[o], inStart[o + 1])
+			vector<unsigned int> inList;
+			unsigned int unitStart[NUM_FU_CLASSES + 1];
+
+			unsigned int ii;
+			vector<int> time;	//issue cycle of each operation, -1 while it has none
+			vector<int> lastTime;	//the cycle it had last, -1 if never placed
+			vector<unsigned int> table;	//modulo reservation table: operation on each unit in each cycle mod ii
+			priority_queue<pair<unsigned int, unsigned int> > queue;	//(height, ops.size() - operation) of the unplaced ones
+			unsigned long long steps;
+			bool timedOut;
+
+			int Latency(const sched_dep& dep) const {	//cycles from the issue of the producer to that of the consumer, in this iteration
+				return (int)(ops[dep.src].delay + dep.transfer) - (int)(ii * dep.distance);
+			}
+
+			unsigned int* Row(unsigned int cycle, fu_class fu) {	//the units of class fu in cycle mod ii
+				return &table[(size_t)(cycle % ii) * unitStart[NUM_FU_CLASSES] + unitStart[fu]];
+			}
+
+			bool Free(unsigned int o, int t) {	//a unit of its class in every cycle o would hold it; an op longer than ii takes several
+				const sched_op& op = ops[o];
+				unsigned int nUnits = config.units[op.fu];
+				for (unsigned int c = 0; c < op.occupancy; c ++) {
+					unsigned int* row = Row(t + c, op.fu);
+					unsigned int taken = 0;
+					for (unsigned int u = 0; u < nUnits; u ++) taken += (row[u] != noOp);
+					for (unsigned int d = c + ii; d < op.occupancy; d += ii) taken ++;	//the same cycle mod ii again
+					if (taken >= nUnits) return false;
+				}
+				return true;
+			}
+
+			// Puts o at t, taking out the operations that hold the units it needs and the consumers
+			// it now starts too late for. Returns the change in the number of placed operations.
+			int Place(unsigned int o, int t) {
+				const sched_op& op = ops[o];
+				int placed = 1;
+				for (unsigned int c = 0; c < op.occupancy; c ++) {
+					unsigned int* row = Row(t + c, op.fu);
+					unsigned int u = 0;
+					while (u < config.units[op.fu] && row[u] != noOp) u ++;
+					if (u == config.units[op.fu]) {	//all held: free the first unit held by another operation
+						u = 0;
+						while (row[u] == o) u ++;
+						placed -= Remove(row[u]);
+					}
+					row[u] = o;
+				}
+				time[o] = lastTime[o] = t;
+
+				for (unsigned int d = outStart[o]; d < outStart[o + 1]; d ++) {
+					const sched_dep& dep = deps[d];
+					if (time[dep.dst] >= 0 && t + Latency(dep) > time[dep.dst]) placed -= Remove(dep.dst);
+				}
+				return placed;
+			}
+
+			int Remove(unsigned int o) {	//back into the queue, 1 if it was placed
+				if (time[o] < 0) return 0;
+				const sched_op& op = ops[o];
+				for (unsigned int c = 0; c < op.occupancy; c ++) {
+					unsigned int* row = Row(time[o] + c, op.fu);
+					for (unsigned int u = 0; u < config.units[op.fu]; u ++)
+						if (row[u] == o) {
+							row[u] = noOp;
+							break;
+						}
+				}
+				time[o] = -1;
+				queue.push(make_pair(op.height, ops.size() - o));
+				return 1;
+			}
+	};
+}
+
+void modulo_scheduler::Schedule(const clust_graph& graph, unsigned int recMII, unsigned int minII, loop_schedule& schedule) const {
+	ims_search search(graph, config);
+	schedule.resMII = search.ResMII();
+	schedule.recMII = recMII;
+	schedule.ii = 0;
+	schedule.stages = 0;
+	schedule.length = 0;
+	schedule.operations = search.NumOps();
+	schedule.timedOut = false;
+	schedule.cycle.assign(graph.NumNodes(), -1);
+	if (!search.NumOps()) return;
+
+	double deadline = (config.budget > 0) ? TimeRecord::getCurrentTime(true).getWallTime() + config.budget : 0;
+	minII = max(max(max(schedule.resMII, recMII), minII), 1U);
+	unsigned int maxII = minII + search.Delays();
+	unsigned int ii = minII;
+	while (ii <= maxII && !search.Run(ii, deadline)) {
+		if (search.TimedOut()) {
+			schedule.timedOut = true;
+			return;
+		}
+		ii ++;
+	}
+	if (ii > maxII) return;
+
+	int first = search.Time(0);	//the first issue goes to cycle 0
+	for (unsigned int o = 1; o < search.NumOps(); o ++) first = min(first, search.Time(o));
+	schedule.ii = ii;
+	for (unsigned int o = 0; o < search.NumOps(); o ++) {
+		const sched_op& op = search.Op(o);
+		int cycle = search.Time(o) - first;
+		schedule.cycle[op.node] = cycle;
+		schedule.length = max(schedule.length, cycle + max(op.delay, 1U));
+		schedule.stages = max(schedule.stages, cycle / ii + 1);
+	}
+}
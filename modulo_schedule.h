@@ -0,0 +1,78 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for modulo_schedule.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _MODULO_SCHEDULE_H_
+#define _MODULO_SCHEDULE_H_ 1
+
+#include "loop_graph_analysis.h"
+#include <vector>
+
+typedef struct
+{
+	unsigned int units[NUM_FU_CLASSES];	//functional units of each class, units[FU_NONE] is not used
+	unsigned int transfer;	//cycles added to every data and control dependence off the recurrences, to move the value between units
+	double budget;	//wall clock seconds the schedule of one loop may take, 0 for no limit
+}schedule_config;
+
+typedef struct
+{
+	unsigned int resMII;	//the largest share of the operations of a class per unit, rounded up
+	unsigned int recMII;	//of the final graph, see clust_graph::RecMII
+	unsigned int ii;	//achieved initiation interval, 0 if no schedule was found
+	unsigned int stages;	//iterations in flight: the last issue cycle / ii, plus one
+	unsigned int length;	//cycles from the first issue to the last result of an iteration
+	unsigned int operations;	//nodes scheduled
+	bool timedOut;	//the budget ran out before a schedule was found
+	std::vector<int> cycle;	//issue cycle of each node by index, -1 for nodes without one; the stage is cycle / ii
+}loop_schedule;
+
+// Iterative modulo scheduling (B. R. Rau, MICRO 27, 1994) of the final loop graph.
+// The operations are the live instruction nodes. An operation holds a unit of
+// its class for its ii cycles, PHIs need none, and every edge between two
+// operations asks the consumer to issue at least the latency of the producer
+// minus ii * distance cycles after it. Data nodes are live-ins and constants.
+//
+// The search starts at the larger of ResMII, RecMII and minII. For each II the
+// operations are placed by height, each in the first cycle of its window of II
+// cycles with a free unit. When there is none, it is placed anyway and whatever is
+// in its way is taken out again, as are the consumers it now starts too late for.
+// After a number of steps proportional to the operations the II grows by one.
+// The result only depends on the graph and the units; the wall clock budget of
+// the loop can only cut the search short. One instance serves all threads.
+class modulo_scheduler
+{
+	public:
+		explicit modulo_scheduler(const schedule_config& config) : config(config) {}
+
+		void Schedule(const clust_graph& graph, unsigned int recMII, unsigned int minII, loop_schedule& schedule) const;	//the graph is finalized, with the SCCs of FindRecurrences()
+		const schedule_config& Config() const { return config; }
+
+	private:
+		schedule_config config;
+};
+
+#endif //_MODULO_SCHEDULE_H_
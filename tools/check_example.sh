@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+# in a sequential program given in high level language like C/C++ into a DFG.
+# This script checks the graphs of the simpleAdder example against the expected ones.
+# For complete list of authors refer to AUTHORS.txt.
+# For more details about the license refer to LICENSE.txt.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Usage: tools/check_example.sh opt loop_graph_analysis_0.so [input.ll]
+#
+# Runs the pass with the default options on simpleAdder.ll (or input.ll, the
+# same program in the IR syntax of another LLVM release) and compares the
+# .graph and .dot files it writes with simpleAdder.graph and simpleAdder.dot
+# byte for byte. OPT_FLAGS are passed to opt before -load. Exits with status 1
+# and shows the differences if they are not the same.
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 opt loop_graph_analysis_0.so [input.ll]" >&2
+	exit 2
+fi
+
+top=$(cd "$(dirname "$0")/.." && pwd)
+opt=$1
+pass=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+input=${3:-$top/simpleAdder.ll}
+case $input in /*) ;; *) input=$(pwd)/$input ;; esac
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+if ! (cd "$work" && "$opt" $OPT_FLAGS -load "$pass" -loop-graph-analysis-0 -dfg-quiet "$input" -o /dev/null > stdout.txt); then
+	echo "opt failed" >&2
+	exit 1
+fi
+
+status=0
+for suffix in graph dot; do
+	if ! diff "$top/simpleAdder.$suffix" "$work/0.loop_analysis_graph.$suffix"; then
+		echo "simpleAdder.$suffix differs" >&2
+		status=1
+	fi
+done
+[ $status -eq 0 ] && echo "simpleAdder: .graph and .dot as expected"
+exit $status
@@ -0,0 +1,275 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file converts loop graphs between the .graph text and .dfgb binary formats.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "dfg_binary.h"
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Usage:
+//	dfg_convert -text N.loop_analysis_graph.dfgb N.loop_analysis_graph.graph
+//	dfg_convert -binary N.loop_analysis_graph.graph N.loop_analysis_graph.dfgb
+//
+// -text writes exactly what the pass writes for the .graph file without
+// -dfg-schedule, so a binary file converted to text can be compared byte for
+// byte with the text output of the same run. The binary format has no schedule:
+// -binary skips the schedule section of a .graph file and -text never writes
+// one, nor the empty access section that precedes it. The text format has no
+// initiation intervals or functional units and only the latencies of nodes with
+// a recurrence edge; the binary file made from it has latency -1 for the other
+// nodes, ii 0 and fu 0 (FU_NONE).
+
+static bool ToText(const char* inName, const char* outName) {
+	dfgb_reader graph;
+	if (!graph.Open(inName)) {
+		fprintf(stderr, "%s: %s\n", inName, graph.Error());
+		return false;
+	}
+
+	FILE* lf = fopen(outName, "w");
+	if (!lf) {
+		fprintf(stderr, "%s: cannot open for writing\n", outName);
+		return false;
+	}
+
+	const dfgb_header& header = graph.Header();
+	const dfgb_node* nodes = graph.Nodes();
+	fprintf(lf, "%lu\t%u\t%.5lf\n", (unsigned long)header.nNodes, header.maxDepth, header.cov);
+
+	for (uint32_t n = 0; n < header.nNodes; n ++) {	//for each node, in id order
+		const dfgb_edge* out = graph.OutEdges();
+		const dfgb_edge* in = graph.InEdges();
+		long outDeg = 0, inDeg = 0;	//back-edges are not in the text
+		for (uint32_t k = graph.OutStart()[n]; k < graph.OutStart()[n + 1]; k ++)
+			if (!(out[k].flags & DFGB_BACKEDGE)) outDeg ++;
+		for (uint32_t k = graph.InStart()[n]; k < graph.InStart()[n + 1]; k ++)
+			if (!(in[k].flags & DFGB_BACKEDGE)) inDeg ++;
+
+		fprintf(lf, "%u\t%.0lf\t%c\t%c\t%ld", nodes[n].depth, nodes[n].wt, nodes[n].kind, nodes[n].type, outDeg);
+
+		for (uint32_t k = graph.OutStart()[n]; k < graph.OutStart()[n + 1]; k ++) {	//for each edge
+			if (out[k].flags & DFGB_BACKEDGE) continue;
+			const dfgb_node& target = nodes[out[k].node];
+			fprintf(lf, "\t%u\t%c\t%.0lf", target.id, out[k].dep, target.wt);
+		}
+
+		fprintf(lf, "\t%ld", inDeg);
+
+		for (uint32_t k = graph.InStart()[n]; k < graph.InStart()[n + 1]; k ++) {	//for each incoming edge
+			if (in[k].flags & DFGB_BACKEDGE) continue;
+			const dfgb_node& source = nodes[in[k].node];
+			fprintf(lf, "\t%u\t%c\t%.0lf", source.id, in[k].dep, (in[k].dep == 'D') ? source.wt : nodes[n].wt);
+		}
+
+		fprintf(lf, "\t%u\n", nodes[n].slack);
+	}
+
+	const dfgb_edge* out = graph.OutEdges();	//recurrence edges, by source node
+	unsigned int nRecurrences = 0;
+	for (uint32_t k = 0; k < header.nEdges; k ++)
+		if (out[k].flags & DFGB_BACKEDGE) nRecurrences ++;
+	fprintf(lf, "%u\t%u\n", nRecurrences, header.recMII);
+	for (uint32_t n = 0; n < header.nNodes; n ++) {
+		for (uint32_t k = graph.OutStart()[n]; k < graph.OutStart()[n + 1]; k ++) {
+			if (!(out[k].flags & DFGB_BACKEDGE)) continue;
+			char distance[16] = "?";
+			if (out[k].distance != DFGB_UNKNOWN_DISTANCE) snprintf(distance, sizeof(distance), "%u", out[k].distance);
+			fprintf(lf, "%u\t%u\t%c\t%s\t%d\n", nodes[n].id, nodes[out[k].node].id, out[k].dep, distance, nodes[n].latency);
+		}
+	}
+
+	if (header.nAccesses > 0) {	//affine accesses, in node order
+		fprintf(lf, "%u\t%s\n", header.nAccesses, graph.Strings() + header.tripCount);
+		for (uint32_t a = 0; a < header.nAccesses; a ++) {
+			const dfgb_access& access = graph.Accesses()[a];
+			fprintf(lf, "%u\t%lld\t%s\n", nodes[access.node].id, (long long)access.stride, graph.Strings() + access.base);
+		}
+	}
+
+	return fclose(lf) == 0;
+}
+
+static bool ReadEdges(FILE* lf, unsigned long nNodes, vector<dfgb_edge>& edges) {	//count followed by (id, dep, wt) triples
+	long deg;
+	if (fscanf(lf, "%ld", &deg) != 1 || deg < 0) return false;
+	for (long k = 0; k < deg; k ++) {
+		unsigned long id;
+		char dep;
+		double wt;
+		if (fscanf(lf, "%lu %c %lf", &id, &dep, &wt) != 3 || id < 1 || id > nNodes) return false;
+
+		dfgb_edge edge;
+		memset(&edge, 0, sizeof(edge));
+		edge.node = id - 1;	//the pass numbers the nodes of a loop 1..n
+		edge.dep = dep;
+		edges.push_back(edge);
+	}
+	return true;
+}
+
+static bool ReadRest(FILE* lf, string& text) {	//the rest of the line after a tab, not empty
+	if (fgetc(lf) != '\t') return false;
+	text.clear();
+	for (int c = fgetc(lf); c != '\n' && c != EOF; c = fgetc(lf)) text += (char)c;
+	return !text.empty();
+}
+
+static bool ToBinary(const char* inName, const char* outName) {
+	FILE* lf = fopen(inName, "r");
+	if (!lf) {
+		fprintf(stderr, "%s: cannot open\n", inName);
+		return false;
+	}
+
+	unsigned long nNodes;
+	unsigned int maxDepth;
+	double cov;
+	if (fscanf(lf, "%lu %u %lf", &nNodes, &maxDepth, &cov) != 3) {
+		fprintf(stderr, "%s: bad header line\n", inName);
+		fclose(lf);
+		return false;
+	}
+
+	vector<dfgb_node> nodes(nNodes);
+	vector<vector<dfgb_edge> > outRows(nNodes), inRows(nNodes);
+
+	for (unsigned long n = 0; n < nNodes; n ++) {
+		dfgb_node& node = nodes[n];
+		memset(&node, 0, sizeof(node));
+		node.id = n + 1;
+		node.latency = -1;
+		if (fscanf(lf, "%u %lf %c %c", &node.depth, &node.wt, &node.kind, &node.type) != 4
+				|| !ReadEdges(lf, nNodes, outRows[n]) || !ReadEdges(lf, nNodes, inRows[n])
+				|| fscanf(lf, "%u", &node.slack) != 1) {
+			fprintf(stderr, "%s: bad line for node %lu\n", inName, n + 1);
+			fclose(lf);
+			return false;
+		}
+	}
+
+	unsigned long nRecurrences;	//recurrence edges go behind the other edges of their rows
+	unsigned int recMII;
+	if (fscanf(lf, "%lu %u", &nRecurrences, &recMII) != 2) {
+		fprintf(stderr, "%s: bad recurrence line\n", inName);
+		fclose(lf);
+		return false;
+	}
+	for (unsigned long r = 0; r < nRecurrences; r ++) {
+		unsigned long src, dst;
+		char dep;
+		char distance[16];	//a number, or ? if unknown
+		int latency;
+		if (fscanf(lf, "%lu %lu %c %15s %d", &src, &dst, &dep, distance, &latency) != 5
+				|| src < 1 || src > nNodes || dst < 1 || dst > nNodes) {
+			fprintf(stderr, "%s: bad recurrence edge %lu\n", inName, r + 1);
+			fclose(lf);
+			return false;
+		}
+		nodes[src - 1].latency = latency;
+
+		dfgb_edge edge;
+		memset(&edge, 0, sizeof(edge));
+		edge.dep = dep;
+		edge.flags = DFGB_BACKEDGE;
+		edge.distance = (strcmp(distance, "?") == 0) ? DFGB_UNKNOWN_DISTANCE : strtoul(distance, 0, 10);
+		edge.node = dst - 1;
+		outRows[src - 1].push_back(edge);
+		edge.node = src - 1;
+		inRows[dst - 1].push_back(edge);
+	}
+
+	unsigned long nAccesses = 0;	//the section of affine accesses is there if the loop has any or has a modulo schedule
+	vector<dfgb_access> accesses;
+	string strings, text;
+	if (fscanf(lf, "%lu", &nAccesses) == 1) {
+		if (!ReadRest(lf, text)) {
+			fprintf(stderr, "%s: bad trip count\n", inName);
+			fclose(lf);
+			return false;
+		}
+		if (nAccesses) strings.append(text.c_str(), text.size() + 1);	//the trip count goes first
+	}
+	for (unsigned long a = 0; a < nAccesses; a ++) {
+		unsigned long id;
+		long long stride;
+		if (fscanf(lf, "%lu %lld", &id, &stride) != 2 || id < 1 || id > nNodes || !ReadRest(lf, text)) {
+			fprintf(stderr, "%s: bad affine access %lu\n", inName, a + 1);
+			fclose(lf);
+			return false;
+		}
+		dfgb_access access;
+		memset(&access, 0, sizeof(access));
+		access.node = id - 1;
+		access.base = strings.size();
+		access.stride = stride;
+		accesses.push_back(access);
+		strings.append(text.c_str(), text.size() + 1);
+	}
+	fclose(lf);	//a modulo schedule may follow, .dfgb files have none
+
+	vector<uint32_t> outStart(1, 0), inStart(1, 0);
+	vector<dfgb_edge> outEdges, inEdges;
+	for (unsigned long n = 0; n < nNodes; n ++) {
+		outEdges.insert(outEdges.end(), outRows[n].begin(), outRows[n].end());
+		inEdges.insert(inEdges.end(), inRows[n].begin(), inRows[n].end());
+		outStart.push_back(outEdges.size());
+		inStart.push_back(inEdges.size());
+	}
+
+	if (outEdges.size() != inEdges.size()) {
+		fprintf(stderr, "%s: out-edges and in-edges do not match\n", inName);
+		return false;
+	}
+
+	const char* base = strrchr(inName, '/');	//the loop id is the first part of the file name
+	dfgb_header header;
+	dfgb_InitHeader(header, strtoul(base ? base + 1 : inName, 0, 10), nNodes, outEdges.size(), maxDepth, cov, accesses.size(), strings.size());
+	header.recMII = recMII;
+	header.tripCount = 0;
+
+	FILE* bf = fopen(outName, "wb");
+	if (!bf) {
+		fprintf(stderr, "%s: cannot open for writing\n", outName);
+		return false;
+	}
+	bool ok = dfgb_Write(bf, header, nodes.empty() ? 0 : &nodes[0], &outStart[0],
+			outEdges.empty() ? 0 : &outEdges[0], &inStart[0], inEdges.empty() ? 0 : &inEdges[0],
+			accesses.empty() ? 0 : &accesses[0], strings.data());
+	return (fclose(bf) == 0) && ok;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 4 && strcmp(argv[1], "-text") == 0) return ToText(argv[2], argv[3]) ? 0 : 1;
+	if (argc == 4 && strcmp(argv[1], "-binary") == 0) return ToBinary(argv[2], argv[3]) ? 0 : 1;
+
+	fprintf(stderr, "usage: %s -text in.dfgb out.graph\n", argv[0]);
+	fprintf(stderr, "       %s -binary in.graph out.dfgb\n", argv[0]);
+	return 2;
+}
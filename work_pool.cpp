@@ -0,0 +1,121 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This file implements the work-stealing thread pool used to build loop graphs.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "work_pool.h"
+#include "llvm/Support/Mutex.h"
+#include <deque>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+	struct worker_queue {	//tasks owned by one worker
+		sys::Mutex lock;
+		deque<unsigned int> tasks;
+	};
+
+	struct worker_args {
+		pool_job* job;
+		worker_queue* queues;
+		unsigned int nWorkers;
+		unsigned int self;
+	};
+
+	bool PopOwn(worker_queue& queue, unsigned int& task) {	//owner takes the most recently added task
+		sys::ScopedLock guard(queue.lock);
+		if (queue.tasks.empty()) return false;
+		task = queue.tasks.back();
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool Steal(worker_queue& queue, unsigned int& task) {	//thieves take the oldest task
+		sys::ScopedLock guard(queue.lock);
+		if (queue.tasks.empty()) return false;
+		task = queue.tasks.front();
+		queue.tasks.pop_front();
+		return true;
+	}
+
+	void* WorkerMain(void* arg) {
+		worker_args* args = (worker_args*)arg;
+		unsigned int task;
+
+		for (;;) {
+			if (PopOwn(args->queues[args->self], task)) {
+				args->job->Run(task);
+				continue;
+			}
+
+			bool stolen = false;	//own queue is empty, try the others in turn
+			for (unsigned int v = 1; v < args->nWorkers && !stolen; v ++)
+				stolen = Steal(args->queues[(args->self + v) % args->nWorkers], task);
+			if (!stolen) break;	//no task is ever added once the pool runs, so all work is taken
+			args->job->Run(task);
+		}
+		return 0;
+	}
+}
+
+unsigned int HardwareThreads() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (unsigned int)n : 1;
+}
+
+void RunWorkStealing(pool_job& job, unsigned int nTasks, unsigned int nThreads) {
+	if (nThreads > nTasks) nThreads = nTasks;
+	if (nThreads <= 1) {	//run inline on the calling thread
+		for (unsigned int t = 0; t < nTasks; t ++) job.Run(t);
+		return;
+	}
+
+	worker_queue* queues = new worker_queue[nThreads];
+	for (unsigned int t = 0; t < nTasks; t ++)	//deal tasks round robin, each worker starts with its lowest task
+		queues[t % nThreads].tasks.push_front(t);
+
+	vector<worker_args> args(nThreads);
+	vector<pthread_t> threads(nThreads);
+	for (unsigned int w = 0; w < nThreads; w ++) {
+		args[w].job = &job;
+		args[w].queues = queues;
+		args[w].nWorkers = nThreads;
+		args[w].self = w;
+	}
+
+	vector<bool> started(nThreads, false);
+	for (unsigned int w = 1; w < nThreads; w ++)	//the calling thread is worker 0
+		started[w] = (pthread_create(&threads[w], 0, WorkerMain, &args[w]) == 0);
+	WorkerMain(&args[0]);	//a worker that failed to start just leaves its tasks to be stolen
+
+	for (unsigned int w = 1; w < nThreads; w ++)
+		if (started[w]) pthread_join(threads[w], 0);
+	delete[] queues;
+}
@@ -0,0 +1,49 @@
+/*
+ * DFGenTool is a Data Flow Graph (DFG) generation tool, which converts loops
+ * in a sequential program given in high level language like C/C++ into a DFG.
+ * This is the header file for work_pool.cpp.
+ * For complete list of authors refer to AUTHORS.txt.
+ * For more details about the license refer to LICENSE.txt.
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2012 Apala Guha
+ * Copyright (C) 2016 Manideepa Mukherjee
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _WORK_POOL_H_
+#define _WORK_POOL_H_ 1
+
+#include <vector>
+
+// A job is a fixed set of independent tasks numbered 0..n-1. Run() is called
+// from several threads at once, each call with a different task.
+class pool_job
+{
+	public:
+		virtual ~pool_job() {}
+		virtual void Run(unsigned int task) = 0;
+};
+
+// Run every task of job on nThreads threads (the caller is one of them). Tasks
+// are dealt round robin to per-worker deques; a worker takes tasks from the back
+// of its own deque and, once it is empty, steals from the front of the others.
+void RunWorkStealing(pool_job& job, unsigned int nTasks, unsigned int nThreads);
+
+unsigned int HardwareThreads();	//number of online processors
+
+#endif //_WORK_POOL_H_